@@ -48,6 +48,10 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Largest sector count a single READ/WRITE SECTOR command can
+   move.  The count register is 8 bits wide and 0 means 256. */
+#define MAX_XFER_SECTORS 256
+
 /* An ATA device. */
 struct disk {
 	char name[8];               /* Name, e.g. "hd0:1". */
@@ -84,7 +88,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -216,7 +220,7 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, 1);
 	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
 	sema_down (&c->completion_wait);
 	if (!wait_while_busy (d))
@@ -240,7 +244,7 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, 1);
 	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
 	if (!wait_while_busy (d))
 		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
@@ -249,6 +253,96 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	d->write_cnt++;
 	lock_release (&c->lock);
 }
+
+/* Returns the address of the IDX'th sector in the scatter list
+   BUFS, where each buffer holds BUF_SECTORS sectors. */
+static void *
+sector_in_bufs (void *bufs[], size_t buf_sectors, size_t idx) {
+	return (uint8_t *) bufs[idx / buf_sectors]
+		+ (idx % buf_sectors) * DISK_SECTOR_SIZE;
+}
+
+/* Reads BUF_CNT * BUF_SECTORS consecutive sectors starting at
+   SEC_NO from disk D.  The sectors are scattered over BUFS: each
+   of the BUF_CNT buffers receives BUF_SECTORS sectors in turn.
+   The whole run is moved by as few READ SECTOR commands as the
+   controller allows, instead of one command per sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *bufs[],
+		size_t buf_cnt, size_t buf_sectors) {
+	struct channel *c;
+	size_t total = buf_cnt * buf_sectors;
+	size_t done = 0;
+
+	ASSERT (d != NULL);
+	ASSERT (bufs != NULL);
+	ASSERT (buf_sectors > 0);
+
+	c = d->channel;
+	lock_acquire (&c->lock);
+	while (done < total) {
+		size_t cnt = total - done;
+		size_t i;
+
+		if (cnt > MAX_XFER_SECTORS)
+			cnt = MAX_XFER_SECTORS;
+		select_sector (d, sec_no + done, cnt);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		/* The device raises one interrupt per sector it has ready. */
+		for (i = 0; i < cnt; i++, done++) {
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu,
+						d->name, (disk_sector_t) (sec_no + done));
+			input_sector (c, sector_in_bufs (bufs, buf_sectors, done));
+			d->read_cnt++;
+		}
+	}
+	lock_release (&c->lock);
+}
+
+/* Writes BUF_CNT * BUF_SECTORS consecutive sectors starting at
+   SEC_NO to disk D, gathering them from BUFS the same way
+   disk_read_multiple() scatters them.  Returns after the disk has
+   acknowledged the last sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no, void *bufs[],
+		size_t buf_cnt, size_t buf_sectors) {
+	struct channel *c;
+	size_t total = buf_cnt * buf_sectors;
+	size_t done = 0;
+
+	ASSERT (d != NULL);
+	ASSERT (bufs != NULL);
+	ASSERT (buf_sectors > 0);
+
+	c = d->channel;
+	lock_acquire (&c->lock);
+	while (done < total) {
+		size_t cnt = total - done;
+		size_t i;
+
+		if (cnt > MAX_XFER_SECTORS)
+			cnt = MAX_XFER_SECTORS;
+		select_sector (d, sec_no + done, cnt);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		/* Each sector is handed over once DRQ is up, and the device
+		   interrupts after it has taken it. */
+		for (i = 0; i < cnt; i++, done++) {
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu,
+						d->name, (disk_sector_t) (sec_no + done));
+			output_sector (c, sector_in_bufs (bufs, buf_sectors, done));
+			sema_down (&c->completion_wait);
+			d->write_cnt++;
+		}
+	}
+	lock_release (&c->lock);
+}
 
 /* Disk detection and identification. */
 
@@ -402,17 +496,18 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the transfer length CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
+	ASSERT (cnt > 0 && cnt <= MAX_XFER_SECTORS);
+	ASSERT (sec_no + cnt <= d->capacity);
 	ASSERT (sec_no < (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt == MAX_XFER_SECTORS ? 0 : cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -1,7 +1,7 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* An open file. */
 struct file {
@@ -10,12 +10,23 @@ struct file {
 	bool deny_write;            /* Has file_deny_write() been called? */
 };
 
+/* Cache of struct file. */
+static struct kmem_cache *file_cache;
+
+/* Initializes the open file cache. */
+void
+file_init (void) {
+	file_cache = kmem_cache_create ("file", sizeof (struct file), NULL);
+	if (file_cache == NULL)
+		PANIC ("file_init: cannot create file cache");
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) {
-	struct file *file = calloc (1, sizeof *file);
+	struct file *file = kmem_cache_alloc (file_cache);
 	if (inode != NULL && file != NULL) {
 		file->inode = inode;
 		file->pos = 0;
@@ -23,7 +34,7 @@ file_open (struct inode *inode) {
 		return file;
 	} else {
 		inode_close (inode);
-		free (file);
+		kmem_cache_free (file_cache, file);
 		return NULL;
 	}
 }
@@ -54,7 +65,7 @@ file_close (struct file *file) {
 	if (file != NULL) {
 		file_allow_write (file);
 		inode_close (file->inode);
-		free (file);
+		kmem_cache_free (file_cache, file);
 	}
 }
 
@@ -86,6 +97,16 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
 	return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads CNT whole pages from FILE into the page-sized buffers
+ * PAGES, starting at the sector-aligned offset FILE_OFS, with one
+ * disk transfer.  Returns the number of bytes read, which is 0 if
+ * the pages do not lie entirely within the file.
+ * The file's current position is unaffected. */
+off_t
+file_read_pages (struct file *file, void *pages[], size_t cnt, off_t file_ofs) {
+	return inode_read_pages (file->inode, pages, cnt, file_ofs);
+}
+
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
@@ -113,6 +134,18 @@ file_write_at (struct file *file, const void *buffer, off_t size,
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Writes the first SIZE bytes of the CNT page-sized buffers PAGES
+ * into FILE, starting at the sector-aligned offset FILE_OFS, with
+ * one disk transfer for the whole sectors.  Returns the number of
+ * bytes written, which may be less than SIZE if end of file is
+ * reached.
+ * The file's current position is unaffected. */
+off_t
+file_write_pages (struct file *file, void *pages[], size_t cnt, off_t file_ofs,
+		off_t size) {
+	return inode_write_pages (file->inode, pages, cnt, file_ofs, size);
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
@@ -6,7 +6,9 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
@@ -58,11 +60,17 @@ byte_to_sector(const struct inode *inode, off_t pos)
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of struct inode. */
+static struct kmem_cache *inode_cache;
+
 /* Initializes the inode module. */
 void inode_init(void)
 {
 	list_init(&open_inodes);
 	lock_init(&inode_lock);
+	inode_cache = kmem_cache_create("inode", sizeof(struct inode), NULL);
+	if (inode_cache == NULL)
+		PANIC("inode_init: cannot create inode cache");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -129,7 +137,7 @@ inode_open(disk_sector_t sector)
 	}
 
 	/* Allocate memory. */
-	inode = malloc(sizeof *inode);
+	inode = kmem_cache_alloc(inode_cache);
 	if (inode == NULL)
 	{
 		lock_release(&inode_lock);
@@ -185,7 +193,7 @@ void inode_close(struct inode *inode)
 							 bytes_to_sectors(inode->data.length));
 		}
 
-		free(inode);
+		kmem_cache_free(inode_cache, inode);
 	}
 }
 
@@ -251,6 +259,25 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
 	return bytes_read;
 }
 
+/* Reads CNT whole pages of INODE, starting at OFFSET, into the
+ * page-sized buffers PAGES.  File data is laid out contiguously on
+ * disk, so the run is fetched with a single multi-sector transfer.
+ * OFFSET must be sector-aligned.  Returns the number of bytes read,
+ * which is 0 if the pages do not lie entirely within INODE. */
+off_t inode_read_pages(struct inode *inode, void *pages[], size_t cnt,
+					   off_t offset)
+{
+	off_t size = cnt * PGSIZE;
+
+	ASSERT(offset % DISK_SECTOR_SIZE == 0);
+	if (cnt == 0 || offset < 0 || offset + size > inode_length(inode))
+		return 0;
+
+	disk_read_multiple(filesys_disk, byte_to_sector(inode, offset), pages,
+					   cnt, PGSIZE / DISK_SECTOR_SIZE);
+	return size;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
  * less than SIZE if end of file is reached or an error occurs.
@@ -318,6 +345,41 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 	return bytes_written;
 }
 
+/* Writes the first SIZE bytes of the CNT page-sized buffers PAGES
+ * into INODE, starting at OFFSET, which must be sector-aligned.
+ * SIZE covers every page but the last one in full.  File data is
+ * laid out contiguously on disk, so the whole sectors go out with
+ * one multi-sector transfer; only a partial last sector is merged
+ * with what is on disk.  Returns the number of bytes written, which
+ * may be less than SIZE if end of file is reached. */
+off_t inode_write_pages(struct inode *inode, void *pages[], size_t cnt,
+						off_t offset, off_t size)
+{
+	ASSERT(offset % DISK_SECTOR_SIZE == 0);
+	ASSERT(cnt > 0 && size >= (off_t)(cnt - 1) * PGSIZE && size <= (off_t)cnt * PGSIZE);
+
+	if (inode->deny_write_cnt || offset < 0 || offset >= inode_length(inode))
+		return 0;
+	if (size > inode_length(inode) - offset)
+		size = inode_length(inode) - offset;
+
+	size_t full = size / PGSIZE;					/* Whole pages. */
+	size_t tail = size % PGSIZE / DISK_SECTOR_SIZE; /* Whole sectors after them. */
+	off_t rest = size % DISK_SECTOR_SIZE;			/* Bytes of a partial last sector. */
+	disk_sector_t sector = byte_to_sector(inode, offset);
+
+	if (full > 0)
+		disk_write_multiple(filesys_disk, sector, pages, full,
+							PGSIZE / DISK_SECTOR_SIZE);
+	if (tail > 0)
+		disk_write_multiple(filesys_disk, sector + full * (PGSIZE / DISK_SECTOR_SIZE),
+							&pages[full], 1, tail);
+	if (rest > 0 && inode_write_at(inode, (uint8_t *)pages[full] + tail * DISK_SECTOR_SIZE,
+								   rest, offset + size - rest) != rest)
+		return size - rest;
+	return size;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void inode_deny_write(struct inode *inode)
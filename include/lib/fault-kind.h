@@ -0,0 +1,20 @@
+#ifndef __LIB_FAULT_KIND_H
+#define __LIB_FAULT_KIND_H
+
+/* Kinds of paging event timed by the kernel, indexes into the
+   arrays of struct faultstat. */
+#define FAULT_MINOR 0           /* Page zero-filled or already in memory. */
+#define FAULT_MAJOR 1           /* Page read from a file or from swap. */
+#define FAULT_STACK 2           /* Stack grown by a page. */
+#define FAULT_COW 3             /* Write to a merged, copy-on-write page. */
+#define FAULT_EVICT 4           /* Page evicted to free a frame. */
+#define FAULT_KIND_CNT 5
+
+/* Latency histograms have FAULT_HIST_CNT buckets.  Bucket I counts
+   events that took from 2**(I + FAULT_HIST_SHIFT) up to twice that
+   many cycles; the first and last buckets also take everything
+   below and above. */
+#define FAULT_HIST_CNT 20
+#define FAULT_HIST_SHIFT 8
+
+#endif /* lib/fault-kind.h */
@@ -98,8 +98,4 @@ bool hash_empty(struct hash *);
 uint64_t hash_bytes(const void *, size_t);
 uint64_t hash_string(const char *);
 uint64_t hash_int(int);
-// 슬아 추가
-uint64_t page_hash_func(const struct hash_elem *e, void *aux);
-bool page_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux);
-void free_hash_func(struct hash_elem *e, void *aux);
 #endif /* lib/kernel/hash.h */
@@ -0,0 +1,70 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+ *
+ * A balanced binary search tree with O(log n) insertion, deletion
+ * and lookup, and in-order iteration.  Like lists and hash tables,
+ * the tree does not allocate: each structure that can be in a tree
+ * embeds a struct rb_elem, and rb_entry() converts an element back
+ * to the structure that contains it.
+ *
+ * Two elements are considered equal when neither is less than the
+ * other.  A tree never holds two equal elements, which makes it
+ * usable for sets of non-overlapping intervals: with "A ends at or
+ * before B starts" as the ordering, an interval is "equal" to every
+ * interval it overlaps, so rb_insert() rejects overlaps and
+ * rb_find() with a one-byte key returns the interval containing
+ * that byte. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree element. */
+struct rb_elem {
+	struct rb_elem *parent;     /* Parent, or NULL for the root. */
+	struct rb_elem *left;       /* Left child. */
+	struct rb_elem *right;      /* Right child. */
+	bool red;                   /* Node color. */
+};
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+ * structure that RB_ELEM is embedded inside.  Supply the name of
+ * the outer structure STRUCT and the member name MEMBER of the
+ * tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) (RB_ELEM)              \
+		- offsetof (STRUCT, MEMBER)))
+
+/* Compares the value of two tree elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree {
+	struct rb_elem *root;       /* Root, or NULL if empty. */
+	size_t elem_cnt;            /* Number of elements in tree. */
+	rb_less_func *less;         /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+
+/* Search, insertion, deletion. */
+struct rb_elem *rb_insert (struct rb_tree *, struct rb_elem *);
+struct rb_elem *rb_find (struct rb_tree *, const struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+
+/* In-order traversal. */
+struct rb_elem *rb_first (struct rb_tree *);
+struct rb_elem *rb_next (struct rb_elem *);
+
+/* Information. */
+size_t rb_size (struct rb_tree *);
+bool rb_empty (struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
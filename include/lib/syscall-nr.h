@@ -36,6 +36,15 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_MADVISE,                /* Advise on the use of a memory range. */
+	SYS_MLOCK,                  /* Lock a memory range into memory. */
+	SYS_MUNLOCK,                /* Unlock a memory range. */
+	SYS_SHM_CREATE,             /* Create a shared memory object. */
+	SYS_MEMSTAT,                /* Report the memory use of a process. */
+	SYS_SET_RSS_LIMIT,          /* Limit the resident pages of a process. */
+	SYS_FAULTSTAT,              /* Report page fault statistics. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <fault-kind.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -13,6 +15,39 @@ typedef int pid_t;
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
 
+/* Flag for mmap()'s WRITABLE argument: share the mapping with every
+   process that maps the same file shared.  Mappings of shared
+   memory objects (shm_create()) are always shared. */
+#define MAP_SHARED 0x100
+
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect page references in random order. */
+#define MADV_SEQUENTIAL 2       /* Expect page references in sequential order. */
+#define MADV_WILLNEED 3         /* Expect access soon; start reading pages in. */
+#define MADV_DONTNEED 4         /* Do not expect access soon; drop the pages. */
+
+/* Memory use of a process, filled in by memstat().  Counts are in
+   pages.  memstat() and set_rss_limit() take 0 for the calling
+   process, or the pid of one of its children. */
+struct memstat {
+	size_t rss;                 /* Pages resident in memory. */
+	size_t rss_limit;           /* Limit on RSS, or 0 if there is none. */
+	size_t swap;                /* Pages in swap. */
+	size_t faults;              /* Page faults resolved. */
+	size_t major_faults;        /* Page faults that read from disk. */
+};
+
+/* Page fault statistics, filled in by faultstat().  The counts and
+   cycle totals are those of the process; the latency histograms are
+   kept for the whole system.  Arrays are indexed by FAULT_MINOR and
+   the other kinds in <fault-kind.h>. */
+struct faultstat {
+	size_t count[FAULT_KIND_CNT];       /* Events of each kind. */
+	uint64_t cycles[FAULT_KIND_CNT];    /* Cycles they took, in total. */
+	size_t hist[FAULT_KIND_CNT][FAULT_HIST_CNT]; /* Latencies, system-wide. */
+};
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -41,6 +76,13 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int mlock (void *addr, size_t length);
+int munlock (void *addr, size_t length);
+int shm_create (size_t size);
+int memstat (pid_t pid, struct memstat *);
+int set_rss_limit (pid_t pid, size_t pages);
+int faultstat (pid_t pid, struct faultstat *);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -2,23 +2,50 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
+/* Batched unmapping.  PTEs cleared through an mmu_gather are not
+ * invalidated one by one: the TLB is flushed once for the whole
+ * batch, page by page if few were cleared or all at once otherwise,
+ * and the pages queued with mmu_gather_free_page() are freed only
+ * after that flush, so that no stale translation can reach a frame
+ * that has been handed out again. */
+#define MMU_GATHER_VAS 16       /* Above this many pages, flush all. */
+#define MMU_GATHER_PAGES 32     /* Pages freed per batch. */
+
+struct mmu_gather {
+	uint64_t *pml4;                     /* Page map being unmapped. */
+	size_t va_cnt;                      /* # of PTEs cleared. */
+	void *vas[MMU_GATHER_VAS];          /* The first of them. */
+	size_t page_cnt;                    /* # of pages queued. */
+	void *pages[MMU_GATHER_PAGES];      /* Pages to free after flush. */
+};
+
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
+uint64_t *pml4_entry_walk (uint64_t *pml4, const uint64_t va, unsigned shift,
+		bool create);
 uint64_t *pml4_create (void);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
+void pml4_init_tlb (void);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
 void pml4_clear_page (uint64_t *pml4, void *upage);
+void mmu_gather_init (struct mmu_gather *, uint64_t *pml4);
+void mmu_gather_clear_page (struct mmu_gather *, void *upage);
+void mmu_gather_free_page (struct mmu_gather *, void *page);
+void mmu_gather_finish (struct mmu_gather *);
 bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed (uint64_t *pml4, const void *upage);
 void pml4_set_accessed (uint64_t *pml4, const void *upage, bool accessed);
+void pml4_print_stats (void);
 
 #define is_writable(pte) (*(pte) & PTE_W)
 #define is_user_pte(pte) (*(pte) & PTE_U)
@@ -0,0 +1,17 @@
+#ifndef THREADS_MPROF_H
+#define THREADS_MPROF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Kernel heap profiler.  See mprof.c. */
+struct mprof_site;
+
+/* -mprof: Record every malloc() by call site? */
+extern bool mprof_enabled;
+
+struct mprof_site *mprof_alloc (void *caller, size_t block_size, size_t size);
+void mprof_free (struct mprof_site *, size_t size);
+void mprof_dump (void);
+
+#endif /* threads/mprof.h */
@@ -17,7 +17,14 @@ extern size_t user_page_limit;
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_huge_page (enum palloc_flags);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_free_pages (void *pages[], size_t page_cnt);
+void palloc_set_owner (void *page, void *owner);
+void *palloc_get_owner (const void *page);
+void palloc_prezero (void);
+size_t palloc_user_pages (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
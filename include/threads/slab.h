@@ -0,0 +1,20 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <debug.h>
+#include <stddef.h>
+
+/* Object caches.  See slab.c. */
+struct kmem_cache;
+
+/* Puts a newly carved object OBJ into its constructed state. */
+typedef void kmem_ctor (void *obj);
+
+void kmem_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		kmem_ctor *ctor);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -7,6 +7,7 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #ifdef VM
+#include <fault-kind.h>
 #include "vm/vm.h"
 #endif
 
@@ -132,6 +133,16 @@ struct thread
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
 	uintptr_t rsp;
+	int fa_window; // fault-around 창 크기 (페이지 수)
+	void *fa_next; // 순차 접근이라면 다음 폴트가 날 것으로 보이는 주소
+	struct shm_object *shm_fds[SHM_FD_CNT]; // shm_create()로 연 공유 메모리 객체
+	size_t rss;				// 프레임에 올라와 있는 페이지 수
+	size_t rss_limit;		// rss 상한, 0이면 제한 없음 (set_rss_limit())
+	size_t swap_cnt;		// swap 디스크에 내려가 있는 페이지 수
+	size_t fault_cnt;		// 처리한 페이지 폴트 수
+	size_t major_fault_cnt; // 그중 디스크에서 읽어 온 폴트 수
+	size_t fault_kind_cnt[FAULT_KIND_CNT]; // 종류별 폴트와 축출 수 (faultstat())
+	uint64_t fault_cycles[FAULT_KIND_CNT]; // 종류별로 걸린 사이클 합
 #endif
 
 	/* Owned by thread.c. */
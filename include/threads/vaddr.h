@@ -20,6 +20,11 @@
 #define PGSIZE (1 << PGBITS)			/* Bytes in a page. */
 #define PGMASK BITMASK(PGSHIFT, PGBITS) /* Page offset bits (0:12). */
 
+/* Huge pages (bits 0:21), mapped by a single page-directory entry. */
+#define HPGBITS 21						/* Number of offset bits. */
+#define HPGSIZE (1 << HPGBITS)			/* Bytes in a huge page. */
+#define HPGMASK BITMASK(PGSHIFT, HPGBITS) /* Huge page offset bits. */
+
 #define MAX_STACK_SIZE (1 << 20) // 1MB //최대 스택 페이지 사이즈 설정
 
 /* Offset within a page. */
@@ -33,6 +38,9 @@
 /* Round down to nearest page boundary. */
 #define pg_round_down(va) (void *)((uint64_t)(va) & ~PGMASK)
 
+/* Round down to nearest huge page boundary. */
+#define hpg_round_down(va) (void *)((uint64_t)(va) & ~HPGMASK)
+
 /* Kernel virtual address start */
 #define KERN_BASE LOADER_KERN_BASE
 
@@ -0,0 +1,18 @@
+#ifndef VM_AGING_H
+#define VM_AGING_H
+
+struct page;
+struct supplemental_page_table;
+
+/* 모든 주기에 쓰인 페이지의 나이, 작업 집합으로 돌아온 페이지가 이 나이로 시작한다. */
+#define AGE_ACTIVE 0xff
+
+/* -age-ms=MS: aged가 페이지 나이를 갱신하는 주기, 0이면 aged를 띄우지 않는다. */
+extern unsigned aging_interval_ms;
+
+void aging_init(void);
+void aging_add(struct supplemental_page_table *spt);
+void aging_remove(struct supplemental_page_table *spt);
+unsigned aging_score(struct page *page);
+void aging_print_stats(void);
+#endif
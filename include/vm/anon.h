@@ -1,7 +1,10 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <list.h>
+#include <stdint.h>
 #include "vm/vm.h"
 struct page;
+struct ksm_entry;
 enum vm_type;
 
 // enum page_status
@@ -14,6 +17,9 @@ enum vm_type;
 struct anon_page
 {
     int swap_slot; // swap된 데이터들이 저장된 섹터 구역을 의미한다.
+    struct ksm_entry *ksm;     // 같은 내용의 페이지와 병합됐으면 공유 프레임 항목, 아니면 NULL
+    struct list_elem ksm_elem; // ksm_entry의 sharers 리스트용
+    uint32_t ksm_sum;          // ksmd가 지난번에 본 내용의 체크섬
     // struct frame *frame;
     // enum page_status status;
     // void *kva;
@@ -21,5 +27,9 @@ struct anon_page
 
 void vm_anon_init(void);
 bool anon_initializer(struct page *page, enum vm_type type, void *kva);
+int anon_swap_write(void *kva);
+void anon_swap_read(int slot, void *kva);
+void anon_swap_drop(int slot);
+void anon_discard(struct page *page);
 
 #endif
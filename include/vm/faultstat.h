@@ -0,0 +1,11 @@
+#ifndef VM_FAULTSTAT_H
+#define VM_FAULTSTAT_H
+#include <fault-kind.h>
+#include <stdint.h>
+#include <user/syscall.h>
+
+uint64_t faultstat_start(void);
+void faultstat_record(int kind, uint64_t start);
+void faultstat_fill_hist(struct faultstat *st);
+void faultstat_print_stats(void);
+#endif
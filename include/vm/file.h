@@ -6,9 +6,13 @@
 struct page;
 enum vm_type;
 
+struct text_entry;
+
 struct file_page
 {
 	struct load_info *fr;
+	struct text_entry *text;	 // 공유 코드 페이지면 캐시 항목, 아니면 NULL
+	struct list_elem text_elem; // text_entry의 sharers 리스트용
 };
 
 void vm_file_init(void);
@@ -16,4 +20,6 @@ bool file_backed_initializer(struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 			  struct file *file, off_t offset);
 void do_munmap(void *va);
+bool file_text_claim(struct page *page);
+struct frame *text_evict(struct page *page);
 #endif
@@ -0,0 +1,23 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+struct frame;
+struct supplemental_page_table;
+
+/* -ksm=PAGES: 한 번 깨어날 때 훑는 익명 페이지 수, 0이면 ksmd를 띄우지 않는다. */
+extern size_t ksm_pages_to_scan;
+/* -ksm-ms=MS: 두 번의 스캔 사이에 쉬는 시간 */
+extern unsigned ksm_sleep_ms;
+
+void ksm_init(void);
+void ksm_add(struct supplemental_page_table *spt);
+void ksm_remove(struct supplemental_page_table *spt);
+bool ksm_is_merged(struct page *page);
+bool ksm_break(struct page *page);
+struct frame *ksm_evict(struct page *page);
+void ksm_destroy(struct page *page);
+void ksm_print_stats(void);
+#endif
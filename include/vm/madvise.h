@@ -0,0 +1,10 @@
+#ifndef VM_MADVISE_H
+#define VM_MADVISE_H
+#include <stddef.h>
+
+struct supplemental_page_table;
+
+void madvise_init(void);
+int do_madvise(void *addr, size_t length, int advice);
+void madvise_cancel(struct supplemental_page_table *spt);
+#endif
@@ -0,0 +1,9 @@
+#ifndef VM_MEMSTAT_H
+#define VM_MEMSTAT_H
+#include <stddef.h>
+#include <user/syscall.h>
+
+int do_memstat(pid_t pid, struct memstat *st);
+int do_set_rss_limit(pid_t pid, size_t pages);
+int do_faultstat(pid_t pid, struct faultstat *st);
+#endif
@@ -0,0 +1,15 @@
+#ifndef VM_MLOCK_H
+#define VM_MLOCK_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct frame;
+
+/* vm_pin_range()이 한 번에 고정하는 최대 페이지 수 */
+#define PIN_MAX_PAGES 16
+
+int do_mlock(void *addr, size_t length);
+int do_munlock(void *addr, size_t length);
+size_t vm_pin_range(void *addr, size_t size, bool write, struct frame *pins[]);
+void vm_unpin_frames(struct frame *pins[], size_t cnt);
+#endif
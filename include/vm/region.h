@@ -0,0 +1,45 @@
+#ifndef VM_REGION_H
+#define VM_REGION_H
+#include <rbtree.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+struct page;
+struct file;
+struct supplemental_page_table;
+
+/* A contiguous range of the user address space with uniform
+ * backing: an executable segment, an mmap()ed file, a shared memory
+ * mapping or the stack.  Pages in a
+ * region have no struct page until they are first touched; the
+ * fault handler builds it from the region. */
+struct vm_region
+{
+	struct rb_elem elem;  // spt의 regions 트리용
+	void *start;		  // 첫 페이지 주소
+	void *end;			  // 마지막 페이지 다음 주소
+	enum vm_type type;	  // 이 구역에서 만들 페이지의 타입
+	bool writable;
+	bool mmap;			  // mmap으로 만든 구역이면 true (munmap 대상)
+	struct file *file;	  // 이 구역 전용으로 다시 연 파일
+	off_t offset;		  // START에 대응하는 파일 오프셋
+	size_t file_bytes;	  // 파일에서 읽을 바이트 수, 나머지는 0
+	vm_initializer *init; // 첫 폴트 때 내용을 채울 함수
+	int advice;			  // madvise()로 받은 접근 방식 (MADV_NORMAL 등)
+	struct shm_object *shm; // 공유 메모리 구역이면 그 객체, 아니면 NULL
+};
+
+void region_table_init(struct supplemental_page_table *spt);
+struct vm_region *region_create(struct supplemental_page_table *spt,
+								void *start, size_t length, enum vm_type type,
+								bool writable, struct file *file, off_t offset,
+								size_t file_bytes, vm_initializer *init);
+struct vm_region *region_create_stack(struct supplemental_page_table *spt);
+struct vm_region *region_find(struct supplemental_page_table *spt, void *va);
+struct load_info *region_load_info(struct vm_region *region, void *va);
+struct page *region_populate(struct supplemental_page_table *spt, void *va);
+void region_destroy(struct supplemental_page_table *spt, struct vm_region *region);
+bool region_table_copy(struct supplemental_page_table *dst,
+					   struct supplemental_page_table *src);
+void region_table_kill(struct supplemental_page_table *spt);
+#endif
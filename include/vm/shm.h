@@ -0,0 +1,38 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct page;
+struct file;
+struct thread;
+struct shm_object;
+struct shm_slot;
+
+/* shm_create()가 돌려주는 fd는 이 값부터 시작한다. 파일 fd와 겹치지 않는다. */
+#define SHM_FD_BASE 32
+/* 프로세스 하나가 열어 둘 수 있는 공유 메모리 fd 수 */
+#define SHM_FD_CNT 8
+
+struct shared_page
+{
+	struct shm_slot *slot;	// 이 페이지가 매핑하는 공유 객체의 페이지
+	struct list_elem elem; // shm_slot의 sharers 리스트용
+};
+
+void shm_init(void);
+int shm_create(size_t size);
+bool shm_is_fd(int fd);
+void shm_close(int fd);
+void shm_fork(struct thread *parent, struct thread *child);
+void shm_close_all(void);
+void *shm_mmap(void *addr, size_t length, bool writable, int fd, off_t offset);
+void *shm_mmap_file(void *addr, size_t length, bool writable, struct file *file,
+				   off_t offset);
+void shm_get(struct shm_object *obj);
+void shm_put(struct shm_object *obj);
+bool shm_claim(struct page *page);
+struct frame *shm_evict(struct page *page);
+#endif
@@ -2,6 +2,7 @@
 #define VM_VM_H
 #include <stdbool.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include <hash.h>
 enum vm_type
 {
@@ -20,6 +21,12 @@ enum vm_type
 	 * markers, until the value is fit in the int. */
 	VM_STACK = (1 << 3),
 	// VM_WRITABLE = (1 << 4),
+	/* Read-only executable text, shared between processes through
+	 * the text cache in vm/file.c. */
+	VM_TEXT = (1 << 5),
+	/* Shared memory: the frame belongs to a shared memory object
+	 * (vm/shm.c) and is mapped into every process mapping it. */
+	VM_SHARED = (1 << 6),
 
 	/* DO NOT EXCEED THIS VALUE. */
 	VM_MARKER_END = (1 << 31),
@@ -28,6 +35,8 @@ enum vm_type
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/shm.h"
+#include "vm/region.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -52,7 +61,9 @@ struct page
 
 	/* Your implementation */
 	bool writable;
-	struct hash_elem hash_elem; // 해시 테이블에 삽입하기 위해 추가.
+	struct thread *owner;		// 이 페이지를 spt에 가진 프로세스
+	bool locked;				// mlock()으로 고정되어 쫓겨나지 않는다
+	uint8_t age;				// 최근 여덟 주기 동안 쓰였는지, aged가 갱신한다 (aging.c)
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union
@@ -60,6 +71,7 @@ struct page
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
+		struct shared_page shared;
 #ifdef EFILESYS
 		struct page_cache page_cache;
 #endif
@@ -72,6 +84,7 @@ struct frame
 	void *kva;
 	struct page *page;
 	struct thread *owner;
+	int pin_cnt; // 커널이 입출력 중이라 쫓아내면 안 되는 동안 0보다 크다
 };
 
 /* The function table for page operations.
@@ -95,9 +108,20 @@ struct page_operations
 /* Representation of current process's memory space.
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
+struct spt_node;
+struct mmu_gather;
+struct writeback;
 struct supplemental_page_table
 {
-	struct hash vm;
+	struct spt_node *root;	 // 가상 페이지 번호로 찾는 4단계 radix tree
+	struct rb_tree regions;	 // 실행 파일 세그먼트와 mmap 구역
+	struct mmu_gather *tlb; // 여러 페이지를 한꺼번에 해제하는 중이면 그 배치
+	struct writeback *wb;	 // 더러운 파일 페이지를 모아 쓰는 중이면 그 배치
+	struct lock lock;		 // 폴트 처리와 ksmd가 같은 테이블을 동시에 건드리지 않게 한다
+	struct list_elem ksm_elem; // ksmd가 훑는 spt 리스트용
+	struct list_elem age_elem; // aged가 훑는 spt 리스트용
+	bool live;				 // init 이후 kill 전까지 true
+	size_t locked_cnt;		 // mlock()된 페이지 수
 };
 
 #include "threads/thread.h"
@@ -107,8 +131,15 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst,
 void supplemental_page_table_kill(struct supplemental_page_table *spt);
 struct page *spt_find_page(struct supplemental_page_table *spt,
 						   void *va);
+struct page *spt_get_page(struct supplemental_page_table *spt, void *va);
 bool spt_insert_page(struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page);
+typedef bool spt_action_func(struct page *page, void *aux);
+bool spt_apply(struct supplemental_page_table *spt, spt_action_func *action, void *aux);
+
+extern struct kmem_cache *vm_page_cache;
+extern struct kmem_cache *vm_frame_cache;
+extern struct kmem_cache *load_info_cache;
 
 void vm_init(void);
 bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user,
@@ -120,9 +151,23 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage,
 									bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page(struct page *page);
 bool vm_claim_page(void *va);
+bool vm_do_claim_page(struct page *page);
+struct frame *vm_get_frame(void);
+struct frame *vm_try_get_frame(void);
+void vm_free_frame(struct frame *frame);
+void vm_unmap_page(struct page *page);
+bool vm_io_begin(void);
+void vm_io_end(bool released);
+void vm_page_set_frame(struct page *page, struct frame *frame);
+void vm_page_clear_frame(struct page *page);
+void vm_account(size_t *counter, int delta);
+bool vm_rss_over_limit(struct thread *t, size_t cnt);
 enum vm_type page_get_type(struct page *page);
 
 bool is_stack_page(struct page *page);
+bool is_text_page(struct page *page);
+bool is_pinned_page(struct page *page);
+bool is_shared_page(struct page *page);
 // bool is_writable_page(struct page *page);
 // load_segment함수에서 바이너리 파일을 로드할 때 필수적인 정보를 포함하는 구조체 정의
 struct load_info
@@ -133,8 +178,6 @@ struct load_info
 	size_t zero_bytes; // 0으로 채울 바이트 수
 	// uint8_t *upage;
 	bool writable; // 페이지가 쓰기 가능한지 여부
-	// munmap 위함
-	int cnt;
 };
 
 #endif /* VM_VM_H */
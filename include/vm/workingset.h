@@ -0,0 +1,12 @@
+#ifndef VM_WORKINGSET_H
+#define VM_WORKINGSET_H
+#include <stdbool.h>
+
+struct page;
+
+void workingset_init(void);
+void workingset_eviction(struct page *page);
+bool workingset_refault(struct page *page);
+unsigned workingset_writeback_cost(void);
+void workingset_print_stats(void);
+#endif
@@ -0,0 +1,37 @@
+#ifndef VM_WRITEBACK_H
+#define VM_WRITEBACK_H
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct frame;
+
+/* Batched writeback of dirty file pages.  While a batch is set in
+ * spt->wb, a dirty file page that is destroyed hands its frame to
+ * the batch instead of being written at once.  The batch writes its
+ * pages sorted by file offset, each run of adjacent pages with one
+ * disk transfer, and frees the frames afterwards.  A batch holds the
+ * pages of one file; adding a page of another file, or more than
+ * WRITEBACK_PAGES pages, writes out what it has first. */
+#define WRITEBACK_PAGES 16
+
+struct writeback_page
+{
+	off_t offset;		 // 파일 안의 위치, 섹터 단위로 정렬되어 있다
+	off_t bytes;		 // 써야 할 바이트 수, 마지막 페이지가 아니면 PGSIZE
+	struct frame *frame; // 쓸 내용, 쓰고 나면 해제한다
+};
+
+struct writeback
+{
+	struct file *file; // 모아 둔 페이지들의 파일
+	size_t cnt;
+	struct writeback_page pages[WRITEBACK_PAGES];
+};
+
+void writeback_init(struct writeback *wb);
+void writeback_add(struct writeback *wb, struct file *file, off_t offset, off_t bytes,
+				   struct frame *frame);
+void writeback_finish(struct writeback *wb);
+void writeback_print_stats(void);
+#endif
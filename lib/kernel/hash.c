@@ -8,7 +8,6 @@
 #include "hash.h"
 #include "../debug.h"
 #include "threads/malloc.h"
-#include "vm/vm.h"
 
 #define list_elem_to_hash_elem(LIST_ELEM) \
 	list_entry(LIST_ELEM, struct hash_elem, list_elem)
@@ -420,37 +419,3 @@ remove_elem(struct hash *h, struct hash_elem *e)
 	h->elem_cnt--;
 	list_remove(&e->list_elem);
 }
-
-// 내가 추가한 함수들
-// 페이지 해시 함수
-uint64_t page_hash_func(const struct hash_elem *e, void *aux UNUSED)
-{
-	/* hash_entry를 이용하여 해시 테이블에 저장되어 있는 hash_elem
-	포인터를 사용해 원래의 page 구조체 포인터를 얻음*/
-	struct page *p = hash_entry(e, struct page, hash_elem);
-	return hash_bytes(&p->va, sizeof(p->va));
-}
-// 비교 함수
-bool page_less_func(const struct hash_elem *a,
-					const struct hash_elem *b,
-					void *aux UNUSED)
-{
-	struct page *p1 = hash_entry(a, struct page, hash_elem);
-	struct page *p2 = hash_entry(b, struct page, hash_elem);
-	return p1->va < p2->va;
-}
-void free_hash_func(struct hash_elem *e, void *aux)
-{
-
-	struct page *p = hash_entry(e, struct page, hash_elem);
-	// mmap-exit 통과됨 . child로 넘어갈 때 기존 파일 내용들을 저장하고 free 해야함
-	if (VM_TYPE(p->operations->type) == VM_FILE)
-	{
-		if (pml4_is_dirty(thread_current()->pml4, p->va))
-		{
-			file_seek(p->file.fr->file, p->file.fr->offset);
-			file_write(p->file.fr->file, p->frame->kva, p->file.fr->read_bytes);
-		}
-	}
-	free(p);
-}
\ No newline at end of file
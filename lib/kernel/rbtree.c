@@ -0,0 +1,299 @@
+/* Red-black tree.
+
+   See rbtree.h for basic information.  The algorithms follow
+   Cormen et al., "Introduction to Algorithms", chapter 13, with
+   null pointers in place of the sentinel leaf. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+                          struct rb_elem *parent);
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux) {
+	ASSERT (tree != NULL);
+	ASSERT (less != NULL);
+
+	tree->root = NULL;
+	tree->elem_cnt = 0;
+	tree->less = less;
+	tree->aux = aux;
+}
+
+/* Inserts NEW into TREE and returns a null pointer, if no equal
+   element is already in the tree.  If an equal element is already
+   in the tree, returns it without inserting NEW. */
+struct rb_elem *
+rb_insert (struct rb_tree *tree, struct rb_elem *new) {
+	struct rb_elem *parent = NULL;
+	struct rb_elem **link = &tree->root;
+
+	while (*link != NULL) {
+		parent = *link;
+		if (tree->less (new, parent, tree->aux))
+			link = &parent->left;
+		else if (tree->less (parent, new, tree->aux))
+			link = &parent->right;
+		else
+			return parent;
+	}
+
+	new->parent = parent;
+	new->left = new->right = NULL;
+	new->red = true;
+	*link = new;
+	tree->elem_cnt++;
+	insert_fixup (tree, new);
+	return NULL;
+}
+
+/* Finds and returns an element equal to KEY in TREE, or a null
+   pointer if no equal element exists in the tree. */
+struct rb_elem *
+rb_find (struct rb_tree *tree, const struct rb_elem *key) {
+	struct rb_elem *e = tree->root;
+
+	while (e != NULL) {
+		if (tree->less (key, e, tree->aux))
+			e = e->left;
+		else if (tree->less (e, key, tree->aux))
+			e = e->right;
+		else
+			return e;
+	}
+	return NULL;
+}
+
+/* Returns the leftmost element in the subtree rooted at E. */
+static struct rb_elem *
+subtree_min (struct rb_elem *e) {
+	while (e->left != NULL)
+		e = e->left;
+	return e;
+}
+
+/* Puts NEW in OLD's place under OLD's parent. */
+static void
+replace_child (struct rb_tree *tree, struct rb_elem *old,
+               struct rb_elem *new) {
+	if (old->parent == NULL)
+		tree->root = new;
+	else if (old == old->parent->left)
+		old->parent->left = new;
+	else
+		old->parent->right = new;
+	if (new != NULL)
+		new->parent = old->parent;
+}
+
+/* Removes E, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_elem *e) {
+	struct rb_elem *child, *parent;
+	bool removed_red;
+
+	ASSERT (tree->elem_cnt > 0);
+
+	if (e->left == NULL || e->right == NULL) {
+		/* At most one child: splice E out. */
+		child = e->left != NULL ? e->left : e->right;
+		parent = e->parent;
+		removed_red = e->red;
+		replace_child (tree, e, child);
+	} else {
+		/* Two children: move E's successor into E's place. */
+		struct rb_elem *succ = subtree_min (e->right);
+
+		child = succ->right;
+		removed_red = succ->red;
+		if (succ->parent == e)
+			parent = succ;
+		else {
+			parent = succ->parent;
+			replace_child (tree, succ, child);
+			succ->right = e->right;
+			succ->right->parent = succ;
+		}
+		replace_child (tree, e, succ);
+		succ->left = e->left;
+		succ->left->parent = succ;
+		succ->red = e->red;
+	}
+
+	tree->elem_cnt--;
+	if (!removed_red)
+		remove_fixup (tree, child, parent);
+}
+
+/* Returns the smallest element of TREE, or a null pointer if TREE
+   is empty. */
+struct rb_elem *
+rb_first (struct rb_tree *tree) {
+	return tree->root != NULL ? subtree_min (tree->root) : NULL;
+}
+
+/* Returns the element after E in its tree, or a null pointer if E
+   is the largest element. */
+struct rb_elem *
+rb_next (struct rb_elem *e) {
+	if (e->right != NULL)
+		return subtree_min (e->right);
+	while (e->parent != NULL && e == e->parent->right)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (struct rb_tree *tree) {
+	return tree->elem_cnt;
+}
+
+/* Returns true if TREE contains no elements, false otherwise. */
+bool
+rb_empty (struct rb_tree *tree) {
+	return tree->elem_cnt == 0;
+}
+
+/* Rotates the subtree rooted at X to the left. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_elem *x) {
+	struct rb_elem *y = x->right;
+
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	replace_child (tree, x, y);
+	y->left = x;
+	x->parent = y;
+}
+
+/* Rotates the subtree rooted at X to the right. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_elem *x) {
+	struct rb_elem *y = x->left;
+
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	replace_child (tree, x, y);
+	y->right = x;
+	x->parent = y;
+}
+
+static inline bool
+is_red (struct rb_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Restores the red-black properties after inserting red node Z. */
+static void
+insert_fixup (struct rb_tree *tree, struct rb_elem *z) {
+	while (is_red (z->parent)) {
+		struct rb_elem *p = z->parent;
+		struct rb_elem *g = p->parent;
+
+		if (p == g->left) {
+			struct rb_elem *uncle = g->right;
+			if (is_red (uncle)) {
+				p->red = uncle->red = false;
+				g->red = true;
+				z = g;
+			} else {
+				if (z == p->right) {
+					z = p;
+					rotate_left (tree, z);
+					p = z->parent;
+				}
+				p->red = false;
+				g->red = true;
+				rotate_right (tree, g);
+			}
+		} else {
+			struct rb_elem *uncle = g->left;
+			if (is_red (uncle)) {
+				p->red = uncle->red = false;
+				g->red = true;
+				z = g;
+			} else {
+				if (z == p->left) {
+					z = p;
+					rotate_right (tree, z);
+					p = z->parent;
+				}
+				p->red = false;
+				g->red = true;
+				rotate_left (tree, g);
+			}
+		}
+	}
+	tree->root->red = false;
+}
+
+/* Restores the red-black properties after removing a black node
+   whose place was taken by X (possibly null) under PARENT. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_elem *x,
+              struct rb_elem *parent) {
+	while (x != tree->root && !is_red (x)) {
+		if (x == parent->left) {
+			struct rb_elem *w = parent->right;
+			if (is_red (w)) {
+				w->red = false;
+				parent->red = true;
+				rotate_left (tree, parent);
+				w = parent->right;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->right)) {
+					w->left->red = false;
+					w->red = true;
+					rotate_right (tree, w);
+					w = parent->right;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				w->right->red = false;
+				rotate_left (tree, parent);
+				x = tree->root;
+			}
+		} else {
+			struct rb_elem *w = parent->left;
+			if (is_red (w)) {
+				w->red = false;
+				parent->red = true;
+				rotate_right (tree, parent);
+				w = parent->left;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->left)) {
+					w->right->red = false;
+					w->red = true;
+					rotate_left (tree, w);
+					w = parent->left;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				w->left->red = false;
+				rotate_right (tree, parent);
+				x = tree->root;
+			}
+		}
+	}
+	if (x != NULL)
+		x->red = false;
+}
@@ -155,6 +155,41 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+mlock (void *addr, size_t length) {
+	return syscall2 (SYS_MLOCK, addr, length);
+}
+
+int
+munlock (void *addr, size_t length) {
+	return syscall2 (SYS_MUNLOCK, addr, length);
+}
+
+int
+shm_create (size_t size) {
+	return syscall1 (SYS_SHM_CREATE, size);
+}
+
+int
+memstat (pid_t pid, struct memstat *st) {
+	return syscall2 (SYS_MEMSTAT, pid, st);
+}
+
+int
+set_rss_limit (pid_t pid, size_t pages) {
+	return syscall2 (SYS_SET_RSS_LIMIT, pid, pages);
+}
+
+int
+faultstat (pid_t pid, struct faultstat *st) {
+	return syscall2 (SYS_FAULTSTAT, pid, st);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
@@ -0,0 +1,77 @@
+/* Touches fresh pages, grows the stack and pages against an rss cap,
+   and checks that faultstat() counted and timed minor, stack and
+   major faults and evictions, and that the system-wide histograms
+   hold at least the process's own faults. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LIMIT 32
+#define PAGES (4 * LIMIT)
+#define STACK_PAGES 4
+
+static char buf[PAGES * 4096] __attribute__ ((aligned (4096)));
+
+/* Grows the stack by about STACK_PAGES pages, lowest address first,
+   so that every page faults just above the stack pointer.  Returns
+   the bytes written, to keep them from being optimized away. */
+static int __attribute__ ((noinline))
+grow_stack (void)
+{
+  volatile char big[STACK_PAGES * 4096];
+  int i, sum = 0;
+
+  for (i = 0; i < STACK_PAGES; i++)
+    big[i * 4096] = i;
+  for (i = 0; i < STACK_PAGES; i++)
+    sum += big[i * 4096];
+  return sum;
+}
+
+/* Fails unless the process had more events of KIND after than
+   before, with some cycles spent on them. */
+static void
+check_kind (const struct faultstat *before, const struct faultstat *after,
+            int kind, const char *name)
+{
+  size_t hist_cnt = 0;
+  int i;
+
+  if (after->count[kind] <= before->count[kind])
+    fail ("no %s faults counted", name);
+  if (after->cycles[kind] <= before->cycles[kind])
+    fail ("no cycles spent on %s faults", name);
+  for (i = 0; i < FAULT_HIST_CNT; i++)
+    hist_cnt += after->hist[kind][i];
+  if (hist_cnt < after->count[kind])
+    fail ("%s histogram holds %zu, the process alone %zu",
+          name, hist_cnt, after->count[kind]);
+}
+
+void
+test_main (void)
+{
+  static struct faultstat before, after;
+  size_t i;
+
+  CHECK (faultstat (0, &before) == 0, "faultstat");
+  if (grow_stack () != STACK_PAGES * (STACK_PAGES - 1) / 2)
+    fail ("stack pages lost their contents");
+  CHECK (set_rss_limit (0, LIMIT) == 0, "set_rss_limit");
+  for (i = 0; i < PAGES; i++)
+    buf[i * 4096] = i % 251;
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * 4096] != (char) (i % 251))
+      fail ("page %zu has wrong contents", i);
+  CHECK (set_rss_limit (0, 0) == 0, "lift the limit");
+  CHECK (faultstat (0, &after) == 0, "faultstat after paging");
+
+  check_kind (&before, &after, FAULT_MINOR, "minor");
+  check_kind (&before, &after, FAULT_STACK, "stack");
+  check_kind (&before, &after, FAULT_MAJOR, "major");
+  check_kind (&before, &after, FAULT_EVICT, "evict");
+  msg ("counts and histograms");
+  CHECK (faultstat (PID_ERROR, &after) == -1, "faultstat of a stranger");
+}
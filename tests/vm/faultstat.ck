@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(faultstat) begin
+(faultstat) faultstat
+(faultstat) set_rss_limit
+(faultstat) lift the limit
+(faultstat) faultstat after paging
+(faultstat) counts and histograms
+(faultstat) faultstat of a stranger
+(faultstat) end
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Drops the contents of a written array with MADV_DONTNEED and
+   checks that it reads back as zeros, and that bad arguments are
+   rejected. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 4096)
+
+static char buf[SIZE] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  size_t i;
+
+  memset (buf, 0xa5, SIZE);
+  CHECK (madvise (buf, SIZE, MADV_WILLNEED) == 0, "madvise willneed");
+  CHECK (madvise (buf, SIZE, MADV_DONTNEED) == 0, "madvise dontneed");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu has value %02hhx after MADV_DONTNEED (should be 0)",
+            i, buf[i]);
+
+  /* The array is still usable. */
+  memset (buf, 0x5a, SIZE);
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu has value %02hhx after rewrite (should be 5a)",
+            i, buf[i]);
+
+  CHECK (madvise (buf + 1, 4096, MADV_NORMAL) == -1,
+         "madvise misaligned address");
+  CHECK (madvise (buf, 0, MADV_NORMAL) == -1, "madvise zero length");
+  CHECK (madvise (NULL, 4096, MADV_NORMAL) == -1, "madvise null");
+  CHECK (madvise ((void *) 0x8004000000, 4096, MADV_NORMAL) == -1,
+         "madvise kernel address");
+  CHECK (madvise (buf, SIZE, 99) == -1, "madvise bad advice");
+}
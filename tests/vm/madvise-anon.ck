@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-anon) begin
+(madvise-anon) madvise willneed
+(madvise-anon) madvise dontneed
+(madvise-anon) madvise misaligned address
+(madvise-anon) madvise zero length
+(madvise-anon) madvise null
+(madvise-anon) madvise kernel address
+(madvise-anon) madvise bad advice
+(madvise-anon) end
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Reads a mapped file after MADV_WILLNEED and MADV_SEQUENTIAL, and
+   checks that MADV_DONTNEED on the clean mapping reads the file
+   again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+  void *map;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (actual, 4096, 0, handle, 0)) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK (madvise (actual, 4096, MADV_SEQUENTIAL) == 0, "madvise sequential");
+  CHECK (madvise (actual, 4096, MADV_WILLNEED) == 0, "madvise willneed");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+
+  CHECK (madvise (actual, 4096, MADV_DONTNEED) == 0, "madvise dontneed");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read after MADV_DONTNEED reported bad data");
+
+  munmap (map);
+  close (handle);
+}
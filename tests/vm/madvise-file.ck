@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-file) begin
+(madvise-file) open "sample.txt"
+(madvise-file) mmap "sample.txt"
+(madvise-file) madvise sequential
+(madvise-file) madvise willneed
+(madvise-file) madvise dontneed
+(madvise-file) end
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Caps the resident set of the process with set_rss_limit(), writes
+   an array four times the cap, and checks with memstat() that the
+   process stayed under the cap by paging against itself. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LIMIT 64
+#define PAGES (4 * LIMIT)
+
+static char buf[PAGES * 4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  pid_t pid = 0;
+  struct memstat st, before;
+  size_t i;
+
+  CHECK (memstat (pid, &before) == 0, "memstat");
+  if (before.rss == 0 || before.rss_limit != 0)
+    fail ("rss %zu, limit %zu before any limit was set",
+          before.rss, before.rss_limit);
+
+  CHECK (set_rss_limit (pid, LIMIT) == 0, "set_rss_limit");
+  for (i = 0; i < PAGES; i++)
+    buf[i * 4096] = i % 251;
+  CHECK (memstat (pid, &st) == 0, "memstat after writing");
+  if (st.rss_limit != LIMIT || st.rss > LIMIT)
+    fail ("rss %zu over limit %zu", st.rss, st.rss_limit);
+  if (st.swap == 0)
+    fail ("nothing was swapped out");
+  if (st.faults < before.faults + PAGES)
+    fail ("only %zu faults for %d new pages",
+          st.faults - before.faults, PAGES);
+
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * 4096] != (char) (i % 251))
+      fail ("page %zu has wrong contents", i);
+  CHECK (memstat (pid, &st) == 0, "memstat after reading back");
+  if (st.rss > LIMIT || st.major_faults == before.major_faults)
+    fail ("rss %zu, %zu major faults after reading swapped pages",
+          st.rss, st.major_faults - before.major_faults);
+
+  CHECK (set_rss_limit (pid, 0) == 0, "lift the limit");
+  CHECK (memstat (PID_ERROR, &st) == -1, "memstat of a stranger");
+  CHECK (set_rss_limit (PID_ERROR, LIMIT) == -1,
+         "set_rss_limit of a stranger");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(memstat) begin
+(memstat) memstat
+(memstat) set_rss_limit
+(memstat) memstat after writing
+(memstat) memstat after reading back
+(memstat) lift the limit
+(memstat) memstat of a stranger
+(memstat) set_rss_limit of a stranger
+(memstat) end
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Locks part of an array into memory, reads a file into it, and
+   checks that mlock() rejects bad and unmapped ranges. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (8 * 4096)
+
+static char buf[SIZE] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  int handle;
+  size_t i;
+
+  CHECK (mlock (buf, SIZE) == 0, "mlock");
+  memset (buf, 0x5a, SIZE);
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, buf + 4000, strlen (sample)) == (int) strlen (sample),
+         "read \"sample.txt\" into locked buffer");
+  if (memcmp (buf + 4000, sample, strlen (sample)))
+    fail ("read into locked buffer reported bad data");
+  for (i = 4000 + strlen (sample); i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu has value %02hhx (should be 5a)", i, buf[i]);
+  close (handle);
+  CHECK (munlock (buf, SIZE) == 0, "munlock");
+
+  CHECK (mlock (buf + 1, 4096) == -1, "mlock misaligned address");
+  CHECK (mlock (buf, 0) == -1, "mlock zero length");
+  CHECK (mlock ((void *) 0x10000000, 4096) == -1, "mlock unmapped");
+  CHECK (mlock ((void *) 0x8004000000, 4096) == -1, "mlock kernel address");
+}
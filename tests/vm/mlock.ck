@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock) begin
+(mlock) mlock
+(mlock) open "sample.txt"
+(mlock) read "sample.txt" into locked buffer
+(mlock) munlock
+(mlock) mlock misaligned address
+(mlock) mlock zero length
+(mlock) mlock unmapped
+(mlock) mlock kernel address
+(mlock) end
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Caps the resident set of the process, maps a file four times the
+   cap read-only and reads it through twice.  Clean file pages are
+   dropped on eviction rather than swapped out, so the second pass
+   reads them back from the file: it must see the same bytes, take
+   major faults, and leave the swap count about where it was. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define LIMIT 32
+#define PAGES (4 * LIMIT)
+
+static char buf[PAGE];
+
+/* Reads every page of MAP and checks its contents. */
+static void
+read_all (const char *map)
+{
+  size_t i, j;
+
+  for (i = 0; i < PAGES; i++)
+    for (j = 0; j < PAGE; j += 512)
+      if (map[i * PAGE + j] != (char) (i % 251 + j / 512))
+        fail ("byte %zu of page %zu is wrong", j, i);
+}
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  struct memstat before, st;
+  int handle;
+  size_t i, j;
+
+  CHECK (create ("reclaim", PAGES * PAGE), "create \"reclaim\"");
+  CHECK ((handle = open ("reclaim")) > 1, "open \"reclaim\"");
+  for (i = 0; i < PAGES; i++)
+    {
+      for (j = 0; j < PAGE; j += 512)
+        memset (buf + j, i % 251 + j / 512, 512);
+      if (write (handle, buf, PAGE) != PAGE)
+        fail ("write page %zu", i);
+    }
+  msg ("fill \"reclaim\"");
+
+  CHECK (mmap (map, PAGES * PAGE, 0, handle, 0) != MAP_FAILED,
+         "mmap \"reclaim\"");
+  CHECK (set_rss_limit (0, LIMIT) == 0, "set_rss_limit");
+  CHECK (memstat (0, &before) == 0, "memstat");
+  read_all (map);
+  read_all (map);
+  CHECK (memstat (0, &st) == 0, "memstat after two passes");
+  if (st.rss > LIMIT)
+    fail ("rss %zu over limit %d", st.rss, LIMIT);
+  if (st.major_faults < before.major_faults + PAGES - LIMIT)
+    fail ("only %zu major faults re-reading %d dropped pages",
+          st.major_faults - before.major_faults, PAGES - LIMIT);
+  if (st.swap > before.swap + LIMIT)
+    fail ("swap grew from %zu to %zu for a clean read-only mapping",
+          before.swap, st.swap);
+  CHECK (set_rss_limit (0, 0) == 0, "lift the limit");
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-reclaim) begin
+(mmap-reclaim) create "reclaim"
+(mmap-reclaim) open "reclaim"
+(mmap-reclaim) fill "reclaim"
+(mmap-reclaim) mmap "reclaim"
+(mmap-reclaim) set_rss_limit
+(mmap-reclaim) memstat
+(mmap-reclaim) memstat after two passes
+(mmap-reclaim) lift the limit
+(mmap-reclaim) end
+EOF
+pass;
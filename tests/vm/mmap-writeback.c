@@ -0,0 +1,79 @@
+/* Writes the pages of a file mapping in reverse order, through a
+   mapping that ends in the middle of a sector, and checks after
+   munmap() that the file holds the written data and nothing beyond
+   the mapping changed.  Then a child maps the end of the file,
+   writes it and exits without unmapping, and the parent checks that
+   the exit wrote the pages back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define FILE_SIZE (5 * PAGE + 700)
+#define MAP_LEN (3 * PAGE + 100)
+#define TAIL_OFS (4 * PAGE)
+
+static char buf[FILE_SIZE];
+
+/* Byte the mapping at OFS wrote, or 'x' if it wrote none. */
+static char
+expected (size_t ofs, bool tail_written)
+{
+  if (ofs < MAP_LEN)
+    return 'a' + ofs / PAGE;
+  if (tail_written && ofs >= TAIL_OFS)
+    return 'A' + (ofs - TAIL_OFS) / PAGE;
+  return 'x';
+}
+
+static void
+verify (int handle, bool tail_written)
+{
+  size_t i;
+
+  seek (handle, 0);
+  if (read (handle, buf, FILE_SIZE) != FILE_SIZE)
+    fail ("short read");
+  for (i = 0; i < FILE_SIZE; i++)
+    if (buf[i] != expected (i, tail_written))
+      fail ("byte %zu is %c, expected %c", i, buf[i],
+            expected (i, tail_written));
+}
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  pid_t child;
+  int handle;
+  int i;
+
+  CHECK (create ("wb", FILE_SIZE), "create \"wb\"");
+  CHECK ((handle = open ("wb")) > 1, "open \"wb\"");
+  memset (buf, 'x', FILE_SIZE);
+  CHECK (write (handle, buf, FILE_SIZE) == FILE_SIZE, "fill \"wb\"");
+
+  CHECK (mmap (map, MAP_LEN, 1, handle, 0) != MAP_FAILED, "mmap \"wb\"");
+  for (i = 3; i >= 0; i--)
+    memset (map + i * PAGE, 'a' + i, i < 3 ? PAGE : MAP_LEN - 3 * PAGE);
+  munmap (map);
+  verify (handle, false);
+  msg ("verify after munmap");
+
+  child = fork ("child-wb");
+  if (child == 0)
+    {
+      int fd = open ("wb");
+      if (mmap (map, FILE_SIZE - TAIL_OFS, 1, fd, TAIL_OFS) == MAP_FAILED)
+        fail ("child mmap failed");
+      memset (map + PAGE, 'B', FILE_SIZE - TAIL_OFS - PAGE);
+      memset (map, 'A', PAGE);
+      exit (0);
+    }
+  CHECK (wait (child) == 0, "wait for child");
+  verify (handle, true);
+  msg ("verify after exit");
+  close (handle);
+}
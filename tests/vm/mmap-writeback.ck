@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-writeback) begin
+(mmap-writeback) create "wb"
+(mmap-writeback) open "wb"
+(mmap-writeback) fill "wb"
+(mmap-writeback) mmap "wb"
+(mmap-writeback) verify after munmap
+(mmap-writeback) wait for child
+(mmap-writeback) verify after exit
+(mmap-writeback) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Same data and shuffles as page-shuffle.
+my ($init) = 3115322833;
+my (@shuffle) = (2274652418, 2281360714, 3504443700, 2850516818, 2406916757,
+		 3377643430, 658047850, 493716582, 3359519593, 143675990);
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<EOF]);
+(page-mix) begin
+(page-mix) init
+(page-mix) sort chunk 0
+(page-mix) sort chunk 1
+(page-mix) sort chunk 2
+(page-mix) sort chunk 3
+(page-mix) sort chunk 4
+(page-mix) sort chunk 5
+(page-mix) sort chunk 6
+(page-mix) sort chunk 7
+(page-mix) init: cksum=$init
+(page-mix) shuffle 0: cksum=$shuffle[0]
+(page-mix) shuffle 1: cksum=$shuffle[1]
+(page-mix) shuffle 2: cksum=$shuffle[2]
+(page-mix) shuffle 3: cksum=$shuffle[3]
+(page-mix) shuffle 4: cksum=$shuffle[4]
+(page-mix) shuffle 5: cksum=$shuffle[5]
+(page-mix) shuffle 6: cksum=$shuffle[6]
+(page-mix) shuffle 7: cksum=$shuffle[7]
+(page-mix) shuffle 8: cksum=$shuffle[8]
+(page-mix) shuffle 9: cksum=$shuffle[9]
+(page-mix) wait for child 0
+(page-mix) wait for child 1
+(page-mix) wait for child 2
+(page-mix) wait for child 3
+(page-mix) wait for child 4
+(page-mix) wait for child 5
+(page-mix) wait for child 6
+(page-mix) wait for child 7
+(page-mix) merge
+(page-mix) verify
+(page-mix) success, buf_idx=1,048,576
+(page-mix) end
+EOF
+pass;
@@ -0,0 +1,43 @@
+/* Maps a shared memory object twice and across fork(), and checks
+   that every mapping sees the same memory. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+
+void
+test_main (void)
+{
+  char *a = (char *) 0x10000000;
+  char *b = (char *) 0x20000000;
+  pid_t child;
+  int fd;
+  size_t i;
+
+  CHECK ((fd = shm_create (SIZE)) > 1, "shm_create");
+  CHECK (mmap (a, SIZE, 1, fd, 0) != MAP_FAILED, "mmap shared memory");
+  CHECK (mmap (b, SIZE, 1, fd, 0) != MAP_FAILED, "mmap shared memory again");
+  memset (a, 'a', SIZE);
+  if (b[0] != 'a' || b[SIZE - 1] != 'a')
+    fail ("second mapping does not see writes to the first");
+
+  child = fork ("child-shm");
+  if (child == 0)
+    {
+      /* The inherited mapping is shared, not copied. */
+      memset (a + 4096, 'b', 4096);
+      exit (0);
+    }
+  CHECK (wait (child) == 0, "wait for child");
+  for (i = 0; i < SIZE; i++)
+    if (b[i] != (i < 4096 ? 'a' : 'b'))
+      fail ("byte %zu has value %c after child wrote", i, b[i]);
+
+  munmap (a);
+  munmap (b);
+  close (fd);
+  CHECK (shm_create (0) == -1, "shm_create zero size");
+}
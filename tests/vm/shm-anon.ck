@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(shm-anon) begin
+(shm-anon) shm_create
+(shm-anon) mmap shared memory
+(shm-anon) mmap shared memory again
+(shm-anon) wait for child
+(shm-anon) shm_create zero size
+(shm-anon) end
+EOF
+pass;
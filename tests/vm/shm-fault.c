@@ -0,0 +1,61 @@
+/* Forks children that share a memory object four times the resident
+   set cap each of them runs under, and has them read it through
+   together.  Every read evicts shared pages from all sharers at
+   once, so the children keep faulting on the same pages at the same
+   time and must wait for each other's reads instead of racing them.
+   Each child checks every byte it sees. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define LIMIT 16
+#define PAGES (4 * LIMIT)
+#define CHILD_CNT 4
+#define PASSES 3
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  pid_t children[CHILD_CNT];
+  int fd;
+  size_t i, j;
+
+  CHECK ((fd = shm_create (PAGES * PAGE)) > 1, "shm_create");
+  CHECK (mmap (map, PAGES * PAGE, 1, fd, 0) != MAP_FAILED,
+         "mmap shared memory");
+  for (i = 0; i < PAGES; i++)
+    memset (map + i * PAGE, i % 251, PAGE);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      children[i] = fork ("child-shm");
+      if (children[i] == 0)
+        {
+          int pass;
+
+          if (set_rss_limit (0, LIMIT) != 0)
+            fail ("set_rss_limit failed");
+          for (pass = 0; pass < PASSES; pass++)
+            for (j = 0; j < PAGES * PAGE; j += 512)
+              if (map[j] != (char) (j / PAGE % 251))
+                fail ("byte %zu is %d in pass %d", j, map[j], pass);
+          exit (0);
+        }
+    }
+  msg ("fork %d children", CHILD_CNT);
+  for (i = 0; i < CHILD_CNT; i++)
+    if (wait (children[i]) != 0)
+      fail ("child %zu failed", i);
+  msg ("wait for children");
+
+  for (i = 0; i < PAGES; i++)
+    if (map[i * PAGE] != (char) (i % 251)
+        || map[i * PAGE + PAGE - 1] != (char) (i % 251))
+      fail ("page %zu changed", i);
+  munmap (map);
+  close (fd);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(shm-fault) begin
+(shm-fault) shm_create
+(shm-fault) mmap shared memory
+(shm-fault) fork 4 children
+(shm-fault) wait for children
+(shm-fault) end
+EOF
+pass;
@@ -0,0 +1,39 @@
+/* Maps a file shared at two addresses, writes through one of them,
+   and checks that the other mapping and the file see the write. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *a = (char *) 0x10000000;
+  char *b = (char *) 0x20000000;
+  const char overwrite[] = "Shared mappings see each other's writes.";
+  char buf[sizeof overwrite];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (a, 4096, 1 | MAP_SHARED, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\" shared");
+  CHECK (mmap (b, 4096, 1 | MAP_SHARED, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\" shared again");
+  if (memcmp (b, sample, strlen (sample)))
+    fail ("read of shared mapping reported bad data");
+
+  memcpy (a, overwrite, strlen (overwrite));
+  if (memcmp (b, overwrite, strlen (overwrite)))
+    fail ("second mapping does not see writes to the first");
+
+  munmap (a);
+  munmap (b);
+  seek (handle, 0);
+  CHECK (read (handle, buf, strlen (overwrite)) == (int) strlen (overwrite),
+         "read \"sample.txt\"");
+  if (memcmp (buf, overwrite, strlen (overwrite)))
+    fail ("file does not hold the write made through the mapping");
+  close (handle);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(shm-file) begin
+(shm-file) open "sample.txt"
+(shm-file) mmap "sample.txt" shared
+(shm-file) mmap "sample.txt" shared again
+(shm-file) read "sample.txt"
+(shm-file) end
+EOF
+pass;
@@ -3,6 +3,7 @@
 #include <debug.h>
 #include <limits.h>
 #include <random.h>
+#include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -15,11 +16,14 @@
 #include "devices/vga.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "intrinsic.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
+#include "threads/mprof.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -31,6 +35,11 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/ksm.h"
+#include "vm/aging.h"
+#include "vm/writeback.h"
+#include "vm/workingset.h"
+#include "vm/faultstat.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -52,6 +61,7 @@ bool power_off_when_done;
 bool thread_tests;
 
 static void bss_init (void);
+static bool cpu_has_gb_pages (void);
 static void paging_init (uint64_t mem_end);
 
 static char **read_command_line (void);
@@ -85,6 +95,7 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	kmem_init ();
 	paging_init (mem_end);
 
 #ifdef USERPROG
@@ -140,9 +151,28 @@ bss_init (void) {
 	memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns true if the CPU can map 1 GB pages
+ * (CPUID.80000001H:EDX.Page1GB[bit 26]). */
+static bool
+cpu_has_gb_pages (void) {
+	uint32_t regs[4];
+
+	cpuid (0x80000000, 0, regs);
+	if (regs[0] < 0x80000001)
+		return false;
+	cpuid (0x80000001, 0, regs);
+	return (regs[3] & (1 << 26)) != 0;
+}
+
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ *
+ * Memory is mapped with the largest pages that fit: 1 GB where
+ * the CPU supports it, then 2 MB.  Only the 2 MB blocks holding
+ * kernel text use 4 kB pages, so that the text alone can be made
+ * read-only.  All of it is global, so it stays in the TLB across
+ * address-space switches. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
@@ -150,21 +180,43 @@ paging_init (uint64_t mem_end) {
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
+	const uint64_t gb = 1UL << PDPESHIFT;
+	uint64_t text_start = vtop (&start) & ~(uint64_t) HPGMASK;
+	uint64_t text_end = ROUND_UP (vtop (&_end_kernel_text), HPGSIZE);
+	bool gb_pages = cpu_has_gb_pages ();
+
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
-		perm = PTE_P | PTE_W;
+		if (gb_pages && pa % gb == 0 && pa + gb <= mem_end
+				&& (pa + gb <= text_start || pa >= text_end)
+				&& (pte = pml4_entry_walk (pml4, va, PDPESHIFT, 1)) != NULL) {
+			*pte = pa | PTE_P | PTE_W | PTE_PS | PTE_G;
+			pa += gb;
+			continue;
+		}
+		if (pa % HPGSIZE == 0 && pa + HPGSIZE <= mem_end
+				&& (pa + HPGSIZE <= text_start || pa >= text_end)
+				&& (pte = pml4_entry_walk (pml4, va, PDXSHIFT, 1)) != NULL) {
+			*pte = pa | PTE_P | PTE_W | PTE_PS | PTE_G;
+			pa += HPGSIZE;
+			continue;
+		}
+
+		perm = PTE_P | PTE_W | PTE_G;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		pa += PGSIZE;
 	}
 
 	// reload cr3
 	pml4_activate(0);
+	pml4_init_tlb ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -221,11 +273,21 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-mprof"))
+			mprof_enabled = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-ksm"))
+			ksm_pages_to_scan = atoi (value);
+		else if (!strcmp (name, "-ksm-ms"))
+			ksm_sleep_ms = atoi (value);
+		else if (!strcmp (name, "-age-ms"))
+			aging_interval_ms = atoi (value);
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -252,6 +314,12 @@ run_task (char **argv) {
 	printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Prints the kernel heap profile. */
+static void
+run_mprof (char **argv UNUSED) {
+	mprof_dump ();
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -266,6 +334,7 @@ run_actions (char **argv) {
 	/* Table of supported actions. */
 	static const struct action actions[] = {
 		{"run", 2, run_task},
+		{"mprof", 1, run_mprof},
 #ifdef FILESYS
 		{"ls", 1, fsutil_ls},
 		{"cat", 2, fsutil_cat},
@@ -312,6 +381,7 @@ usage (void) {
 #else
 			"  run TEST           Run TEST.\n"
 #endif
+			"  mprof              Print the kernel heap profile (needs -mprof).\n"
 #ifdef FILESYS
 			"  ls                 List files in the root directory.\n"
 			"  cat FILE           Print FILE to the console.\n"
@@ -326,8 +396,16 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -mprof             Record kernel heap allocations by call site.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -ksm=PAGES         Merge identical anonymous pages, scanning\n"
+			"                     PAGES pages per wakeup.\n"
+			"  -ksm-ms=MS         Sleep MS milliseconds between scans (default 20).\n"
+			"  -age-ms=MS         Age pages for eviction every MS milliseconds\n"
+			"                     (default 100, 0 to age only while evicting).\n"
 #endif
 			);
 	power_off ();
@@ -359,7 +437,17 @@ print_stats (void) {
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
+	palloc_print_stats ();
+	kmem_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	pml4_print_stats ();
+#endif
+#ifdef VM
+	ksm_print_stats ();
+	aging_print_stats ();
+	writeback_print_stats ();
+	workingset_print_stats ();
+	faultstat_print_stats ();
 #endif
 }
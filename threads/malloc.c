@@ -5,43 +5,73 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/mprof.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   The size of each request, in bytes, is rounded up to the
+   nearest size class, and the request is given to the
+   "descriptor" that manages blocks of that size.  The descriptor
+   keeps a list of free blocks.  If the free list is nonempty,
+   one of its blocks is used to satisfy the request.
 
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
+   Otherwise, a new "arena" is obtained from the page allocator
+   (if none is available, malloc() returns a null pointer).  The
+   new arena is divided into blocks, all of which are added to
+   the descriptor's free list.  Then we return one of the new
+   blocks.
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Small classes use one-page arenas whose header sits at the
+   start of the page.  From 768 bytes up, that header would waste
+   a large share of the page.  Those classes keep the arena header
+   out of line, in a block of its own, and use arenas of one or
+   more pages, sized so that the blocks fill them exactly.  The
+   classes go up to 10 kB and are not all powers of 2, so a
+   1100-byte request costs 1536 bytes rather than two pages.
+
+   Larger requests get "big blocks": runs of whole pages whose
+   header is also out of line, so a 4 kB request takes exactly one
+   page.
+
+   Every page of an arena or big block records its header with
+   palloc_set_owner(), so that free() can find the header of any
+   block.
+
+   With the -mprof option, each block is preceded by a struct
+   mprof_hdr that ties it to its allocation site.  See mprof.c. */
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
+	size_t arena_pages;         /* Number of pages in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
 };
 
+/* Size classes, and the number of pages in each arena. */
+static const struct {
+	size_t block_size;
+	size_t arena_pages;
+} classes[] = {
+	{16, 1}, {32, 1}, {48, 1}, {64, 1}, {96, 1}, {128, 1}, {192, 1},
+	{256, 1}, {384, 1}, {512, 1},
+	{768, 3}, {1024, 1}, {1536, 3}, {2048, 1}, {3072, 3}, {6144, 3},
+	{10240, 5},
+};
+#define CLASS_CNT (sizeof classes / sizeof *classes)
+
+/* Blocks at least this big have out-of-line arena headers. */
+#define OUTLINE_MIN 768
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -50,6 +80,7 @@ struct arena {
 	unsigned magic;             /* Always set to ARENA_MAGIC. */
 	struct desc *desc;          /* Owning descriptor, null for big block. */
 	size_t free_cnt;            /* Free blocks; pages in big block. */
+	uint8_t *base;              /* First block. */
 };
 
 /* Free block. */
@@ -57,32 +88,77 @@ struct block {
 	struct list_elem free_elem; /* Free list element. */
 };
 
+/* Profiling header, in front of every block under -mprof. */
+struct mprof_hdr {
+	struct mprof_site *site;    /* Allocation site. */
+	size_t size;                /* Bytes requested. */
+};
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[CLASS_CNT];    /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *do_malloc (size_t);
+static void do_free (void *);
+static size_t block_size (void *);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
-
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+	for (desc_cnt = 0; desc_cnt < CLASS_CNT; desc_cnt++) {
+		struct desc *d = &descs[desc_cnt];
+		size_t arena_size = classes[desc_cnt].arena_pages * PGSIZE;
+
+		d->block_size = classes[desc_cnt].block_size;
+		d->arena_pages = classes[desc_cnt].arena_pages;
+		if (d->block_size < OUTLINE_MIN)
+			arena_size -= sizeof (struct arena);
+		d->blocks_per_arena = arena_size / d->block_size;
 		list_init (&d->free_list);
 		lock_init (&d->lock);
 	}
 }
 
+/* Records A as the owner of its PAGE_CNT pages starting at PAGES. */
+static void
+set_owner (void *pages, size_t page_cnt, struct arena *a) {
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++)
+		palloc_set_owner ((uint8_t *) pages + i * PGSIZE, a);
+}
+
+/* Allocates a big block of SIZE bytes, in whole pages. */
+static void *
+big_alloc (size_t size) {
+	size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+	struct arena *a = do_malloc (sizeof *a);
+	void *pages;
+
+	if (a == NULL)
+		return NULL;
+	pages = palloc_get_multiple (0, page_cnt);
+	if (pages == NULL) {
+		do_free (a);
+		return NULL;
+	}
+
+	/* Initialize the arena to indicate a big block of PAGE_CNT
+	   pages, and return it. */
+	a->magic = ARENA_MAGIC;
+	a->desc = NULL;
+	a->free_cnt = page_cnt;
+	a->base = pages;
+	set_owner (pages, page_cnt, a);
+	return pages;
+}
+
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
-void *
-malloc (size_t size) {
+static void *
+do_malloc (size_t size) {
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
@@ -96,39 +172,41 @@ malloc (size_t size) {
 	for (d = descs; d < descs + desc_cnt; d++)
 		if (d->block_size >= size)
 			break;
-	if (d == descs + desc_cnt) {
-		/* SIZE is too big for any descriptor.
-		   Allocate enough pages to hold SIZE plus an arena. */
-		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-		a = palloc_get_multiple (0, page_cnt);
-		if (a == NULL)
-			return NULL;
-
-		/* Initialize the arena to indicate a big block of PAGE_CNT
-		   pages, and return it. */
-		a->magic = ARENA_MAGIC;
-		a->desc = NULL;
-		a->free_cnt = page_cnt;
-		return a + 1;
-	}
+	if (d == descs + desc_cnt)
+		return big_alloc (size);
 
 	lock_acquire (&d->lock);
 
 	/* If the free list is empty, create a new arena. */
 	if (list_empty (&d->free_list)) {
 		size_t i;
+		void *pages;
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
+		/* Allocate the pages, and the header if it is out of
+		   line. */
+		pages = palloc_get_multiple (0, d->arena_pages);
+		if (pages == NULL) {
 			lock_release (&d->lock);
 			return NULL;
 		}
+		if (d->block_size < OUTLINE_MIN) {
+			a = pages;
+			a->base = (uint8_t *) (a + 1);
+		} else {
+			a = do_malloc (sizeof *a);
+			if (a == NULL) {
+				palloc_free_multiple (pages, d->arena_pages);
+				lock_release (&d->lock);
+				return NULL;
+			}
+			a->base = pages;
+		}
 
 		/* Initialize arena and add its blocks to the free list. */
 		a->magic = ARENA_MAGIC;
 		a->desc = d;
 		a->free_cnt = d->blocks_per_arena;
+		set_owner (pages, d->arena_pages, a);
 		for (i = 0; i < d->blocks_per_arena; i++) {
 			struct block *b = arena_to_block (a, i);
 			list_push_back (&d->free_list, &b->free_elem);
@@ -143,6 +221,32 @@ malloc (size_t size) {
 	return b;
 }
 
+/* Allocates SIZE bytes on behalf of the function that returns to
+   CALLER, recording it under -mprof. */
+static void *
+malloc_from (size_t size, void *caller) {
+	struct mprof_hdr *h;
+
+	if (!mprof_enabled)
+		return do_malloc (size);
+	if (size == 0)
+		return NULL;
+
+	h = do_malloc (size + sizeof *h);
+	if (h == NULL)
+		return NULL;
+	h->size = size;
+	h->site = mprof_alloc (caller, block_size (h), size);
+	return h + 1;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) {
+	return malloc_from (size, __builtin_return_address (0));
+}
+
 /* Allocates and return A times B bytes initialized to zeroes.
    Returns a null pointer if memory is not available. */
 void *
@@ -156,7 +260,7 @@ calloc (size_t a, size_t b) {
 		return NULL;
 
 	/* Allocate and zero memory. */
-	p = malloc (size);
+	p = malloc_from (size, __builtin_return_address (0));
 	if (p != NULL)
 		memset (p, 0, size);
 
@@ -170,7 +274,7 @@ block_size (void *block) {
 	struct arena *a = block_to_arena (b);
 	struct desc *d = a->desc;
 
-	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+	return d != NULL ? d->block_size : PGSIZE * a->free_cnt;
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -178,13 +282,53 @@ block_size (void *block) {
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
-   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK).
+   The block stays where it is if NEW_SIZE still fits in it; a
+   big block that shrinks gives its trailing pages back. */
 void *
 realloc (void *old_block, size_t new_size) {
+	if (mprof_enabled) {
+		/* Always move, so that the block is charged to this
+		   caller. */
+		void *new_block = NULL;
+
+		if (new_size != 0) {
+			new_block = malloc_from (new_size, __builtin_return_address (0));
+			if (new_block == NULL)
+				return NULL;
+		}
+		if (old_block != NULL) {
+			size_t old_size = ((struct mprof_hdr *) old_block - 1)->size;
+			if (new_block != NULL)
+				memcpy (new_block, old_block,
+						new_size < old_size ? new_size : old_size);
+			free (old_block);
+		}
+		return new_block;
+	}
+
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
 	} else {
+		if (old_block != NULL) {
+			struct arena *a = block_to_arena (old_block);
+			size_t old_size = block_size (old_block);
+
+			if (a->desc == NULL && new_size <= old_size) {
+				/* Shrink a big block in place, unless it would
+				   fit in a size class. */
+				size_t page_cnt = DIV_ROUND_UP (new_size, PGSIZE);
+				if (new_size > descs[desc_cnt - 1].block_size) {
+					palloc_free_multiple (a->base + page_cnt * PGSIZE,
+							a->free_cnt - page_cnt);
+					a->free_cnt = page_cnt;
+					return old_block;
+				}
+			} else if (new_size <= old_size)
+				return old_block;
+		}
+
 		void *new_block = malloc (new_size);
 		if (old_block != NULL && new_block != NULL) {
 			size_t old_size = block_size (old_block);
@@ -200,6 +344,17 @@ realloc (void *old_block, size_t new_size) {
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) {
+	if (p != NULL && mprof_enabled) {
+		struct mprof_hdr *h = (struct mprof_hdr *) p - 1;
+		mprof_free (h->site, h->size);
+		p = h;
+	}
+	do_free (p);
+}
+
+/* Frees block P, allocated by do_malloc(). */
+static void
+do_free (void *p) {
 	if (p != NULL) {
 		struct block *b = p;
 		struct arena *a = block_to_arena (b);
@@ -227,22 +382,28 @@ free (void *p) {
 					struct block *b = arena_to_block (a, i);
 					list_remove (&b->free_elem);
 				}
-				palloc_free_page (a);
+				if (d->block_size < OUTLINE_MIN)
+					palloc_free_page (a);
+				else {
+					palloc_free_multiple (a->base, d->arena_pages);
+					do_free (a);
+				}
 			}
 
 			lock_release (&d->lock);
 		} else {
-			/* It's a big block.  Free its pages. */
-			palloc_free_multiple (a, a->free_cnt);
+			/* It's a big block.  Free its pages and header. */
+			palloc_free_multiple (a->base, a->free_cnt);
+			do_free (a);
 			return;
 		}
 	}
 }
-
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
+	struct arena *a = palloc_get_owner (pg_round_down (b));
 
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
@@ -250,8 +411,8 @@ block_to_arena (struct block *b) {
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
-	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
+			|| ((uint8_t *) b - a->base) % a->desc->block_size == 0);
+	ASSERT (a->desc != NULL || (uint8_t *) b == a->base);
 
 	return a;
 }
@@ -262,7 +423,5 @@ arena_to_block (struct arena *a, size_t idx) {
 	ASSERT (a != NULL);
 	ASSERT (a->magic == ARENA_MAGIC);
 	ASSERT (idx < a->desc->blocks_per_arena);
-	return (struct block *) ((uint8_t *) a
-			+ sizeof *a
-			+ idx * a->desc->block_size);
+	return (struct block *) (a->base + idx * a->desc->block_size);
 }
@@ -1,17 +1,85 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include <debug.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Process-context identifiers.  When the CPU supports them, every
+ * page map in use gets a PCID from a small pool, and CR3 is loaded
+ * with the no-flush bit so that switching address spaces keeps the
+ * TLB entries of the others.  A PCID's entries are flushed only when
+ * it is handed to another page map, or when its page map was changed
+ * while some other one was active.  PCID 0 is the kernel's. */
+#define PCID_CNT 64                     /* Size of the pool. */
+#define CR3_NOFLUSH (1UL << 63)         /* Keep TLB entries on CR3 load. */
+#define CR4_PGE (1 << 7)                /* Global pages enable. */
+#define CR4_PCIDE (1 << 17)             /* PCID enable. */
+
+struct pcid_slot {
+	uint64_t *pml4;                     /* Page map using this PCID. */
+	bool stale;                         /* Flush on next activation? */
+};
+
+static bool pcid_enabled;
+static struct pcid_slot pcid_slots[PCID_CNT];
+static unsigned pcid_hand = 1;          /* Next PCID to hand out. */
+static size_t pcid_switches;            /* # of user page map loads. */
+static size_t pcid_flushes;             /* # of those that flushed. */
+
+static unsigned pcid_find (uint64_t *pml4);
+
+/* mmu_gather statistics. */
+static size_t gather_flushes;   /* # of batches flushed page by page. */
+static size_t gather_full;      /* # of batches flushed as a whole. */
+static size_t gather_pages;     /* # of PTEs cleared through batches. */
+
+/* Huge page statistics. */
+static size_t huge_in_use;      /* # of 2 MB mappings currently live. */
+static size_t huge_mapped;      /* # of 2 MB mappings ever made. */
+static size_t huge_split;       /* # of 2 MB mappings split into 4 kB. */
+
+/* Replaces the 2 MB mapping in PDE with a page table mapping the
+ * same frames with 4 kB PTEs, carrying over the permission,
+ * accessed and dirty bits.  The translation does not change, so no
+ * TLB flush is needed until one of the new PTEs is modified.
+ * Returns false if no page table could be allocated. */
+static bool
+split_huge_pde (uint64_t *pde) {
+	uint64_t *pt = palloc_get_page (0);
+	if (pt == NULL)
+		return false;
+
+	uint64_t pa = PTE_ADDR (*pde);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+
+	huge_in_use--;
+	huge_split++;
+	return true;
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
+		/* A huge page covers VA.  Lookups get its PDE, whose bits
+		 * stand for all 512 pages; anything that needs the 4 kB
+		 * PTE itself splits the huge page first. */
+		if (pdp[idx] & PTE_PS) {
+			if (!create)
+				return &pdp[idx];
+			if (!split_huge_pde (&pdp[idx]))
+				return NULL;
+		}
 		uint64_t *pte = (uint64_t *) pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
@@ -35,6 +103,10 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 	int allocated = 0;
 	if (pdpe) {
 		uint64_t *pde = (uint64_t *) pdpe[idx];
+		/* A 1 GB page (only in the kernel's direct map) covers VA:
+		 * it can be looked up but never split. */
+		if (pdpe[idx] & PTE_PS)
+			return create ? NULL : &pdpe[idx];
 		if (!((uint64_t) pde & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
@@ -122,7 +194,13 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (pdp[i] & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -135,7 +213,12 @@ pdp_for_each (uint64_t *pdp,
 		pte_for_each_func *func, void *aux, unsigned pml4_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pde) & PTE_P)
+		if (pdp[i] & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) i << PDPESHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pde) & PTE_P)
 			if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
 					 aux, pml4_index, i))
 				return false;
@@ -156,33 +239,36 @@ pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 }
 
 static void
-pt_destroy (uint64_t *pt) {
+pt_destroy (uint64_t *pt, struct mmu_gather *tlb) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pt[i]);
 		if (((uint64_t) pte) & PTE_P)
-			palloc_free_page ((void *) PTE_ADDR (pte));
+			mmu_gather_free_page (tlb, (void *) PTE_ADDR (pte));
 	}
-	palloc_free_page ((void *) pt);
+	mmu_gather_free_page (tlb, (void *) pt);
 }
 
 static void
-pgdir_destroy (uint64_t *pdp) {
+pgdir_destroy (uint64_t *pdp, struct mmu_gather *tlb) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			pt_destroy (PTE_ADDR (pte));
+		if (pdp[i] & PTE_PS) {
+			palloc_free_multiple ((void *) PTE_ADDR (pte), HPGSIZE / PGSIZE);
+			huge_in_use--;
+		} else if (((uint64_t) pte) & PTE_P)
+			pt_destroy (PTE_ADDR (pte), tlb);
 	}
-	palloc_free_page ((void *) pdp);
+	mmu_gather_free_page (tlb, (void *) pdp);
 }
 
 static void
-pdpe_destroy (uint64_t *pdpe) {
+pdpe_destroy (uint64_t *pdpe, struct mmu_gather *tlb) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdpe[i]);
 		if (((uint64_t) pde) & PTE_P)
-			pgdir_destroy ((void *) PTE_ADDR (pde));
+			pgdir_destroy ((void *) PTE_ADDR (pde), tlb);
 	}
-	palloc_free_page ((void *) pdpe);
+	mmu_gather_free_page (tlb, (void *) pdpe);
 }
 
 /* Destroys pml4e, freeing all the pages it references. */
@@ -192,18 +278,122 @@ pml4_destroy (uint64_t *pml4) {
 		return;
 	ASSERT (pml4 != base_pml4);
 
-	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
+	/* Give back its PCID, so that a page map created later at the
+	 * same address does not inherit its TLB entries. */
+	if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		unsigned pcid = pcid_find (pml4);
+		if (pcid != 0)
+			pcid_slots[pcid].pml4 = NULL;
+		intr_set_level (old_level);
+	}
+
+	/* if PML4 (vaddr) >= 1, it's kernel space by define.
+	 * The frames and page tables are freed in batches; PML4 is
+	 * not active and has no PCID left, so there is nothing in the
+	 * TLB to flush first. */
+	struct mmu_gather tlb;
+	mmu_gather_init (&tlb, pml4);
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
-		pdpe_destroy ((void *) PTE_ADDR (pdpe));
-	palloc_free_page ((void *) pml4);
+		pdpe_destroy ((void *) PTE_ADDR (pdpe), &tlb);
+	mmu_gather_free_page (&tlb, (void *) pml4);
+	mmu_gather_finish (&tlb);
+}
+
+/* Turns on global pages and, if the CPU has them, PCIDs.  Must be
+ * called once with base_pml4 active. */
+void
+pml4_init_tlb (void) {
+	uint32_t regs[4];
+
+	cpuid (1, 0, regs);
+	if (regs[2] & (1 << 17)) {
+		lcr4 (rcr4 () | CR4_PGE | CR4_PCIDE);
+		pcid_enabled = true;
+	} else
+		lcr4 (rcr4 () | CR4_PGE);
+}
+
+/* Returns the PCID held by PML4, or 0 if it has none. */
+static unsigned
+pcid_find (uint64_t *pml4) {
+	for (unsigned pcid = 1; pcid < PCID_CNT; pcid++)
+		if (pcid_slots[pcid].pml4 == pml4)
+			return pcid;
+	return 0;
+}
+
+/* Returns true if PML4 is the page map the CPU is using. */
+static bool
+is_active (uint64_t *pml4) {
+	return PTE_ADDR (rcr3 ()) == vtop (pml4);
+}
+
+/* Invalidates the TLB entry for VA in PML4 after its PTE changed.
+ * If PML4 is not active, its PCID is flushed as a whole the next
+ * time it is. */
+static void
+flush_page (uint64_t *pml4, const void *va) {
+	if (is_active (pml4))
+		invlpg ((uint64_t) va);
+	else if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		unsigned pcid = pcid_find (pml4);
+		if (pcid != 0)
+			pcid_slots[pcid].stale = true;
+		intr_set_level (old_level);
+	}
+}
+
+/* Invalidates every non-global TLB entry of PML4.  If PML4 is not
+ * active, its PCID is flushed the next time it is; without PCIDs,
+ * loading CR3 already does that. */
+static void
+flush_all (uint64_t *pml4) {
+	if (is_active (pml4)) {
+		/* Without the no-flush bit, this drops the entries of the
+		 * current PCID only. */
+		lcr3 (rcr3 () & ~CR3_NOFLUSH);
+	} else if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		unsigned pcid = pcid_find (pml4);
+		if (pcid != 0)
+			pcid_slots[pcid].stale = true;
+		intr_set_level (old_level);
+	}
 }
 
 /* Loads page directory PD into the CPU's page directory base
  * register. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	if (!pcid_enabled || pml4 == NULL) {
+		/* Kernel-only mappings are all global. */
+		lcr3 (vtop (pml4 ? pml4 : base_pml4) | (pcid_enabled ? CR3_NOFLUSH : 0));
+		return;
+	}
+
+	enum intr_level old_level = intr_disable ();
+	unsigned pcid = pcid_find (pml4);
+	if (pcid == 0) {
+		/* Take the next PCID round-robin.  Its previous owner gets
+		 * a fresh one when it runs again. */
+		pcid = pcid_hand;
+		pcid_hand = pcid_hand + 1 < PCID_CNT ? pcid_hand + 1 : 1;
+		pcid_slots[pcid].pml4 = pml4;
+		pcid_slots[pcid].stale = true;
+	}
+
+	uint64_t cr3 = vtop (pml4) | pcid;
+	if (pcid_slots[pcid].stale) {
+		pcid_slots[pcid].stale = false;
+		pcid_flushes++;
+	} else
+		cr3 |= CR3_NOFLUSH;
+	pcid_switches++;
+	lcr3 (cr3);
+	intr_set_level (old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -216,8 +406,11 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
-	if (pte && (*pte & PTE_P))
+	if (pte && (*pte & PTE_P)) {
+		if (*pte & PTE_PS)
+			return ptov (PTE_ADDR (*pte)) + ((uint64_t) uaddr & HPGMASK);
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+	}
 	return NULL;
 }
 
@@ -243,6 +436,75 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 	return pte != NULL;
 }
 
+/* Returns the entry for VA in PML4 at the level whose entries each
+ * cover 1 << SHIFT bytes: PDPESHIFT for a page-directory-pointer
+ * entry (1 GB), PDXSHIFT for a page-directory entry (2 MB).  The
+ * tables above it are created on the way if CREATE.  Returns a null
+ * pointer if one is missing and CREATE is false, if a large page
+ * already covers VA above that level, or if memory allocation
+ * fails. */
+uint64_t *
+pml4_entry_walk (uint64_t *pml4, const uint64_t va, unsigned shift,
+		bool create) {
+	uint64_t *table = pml4;
+
+	ASSERT (shift == PDPESHIFT || shift == PDXSHIFT);
+	for (unsigned s = PML4SHIFT; s > shift; s -= 9) {
+		uint64_t *e = &table[(va >> s) & 0x1FF];
+		if (!(*e & PTE_P)) {
+			uint64_t *new_page;
+			if (!create || (new_page = palloc_get_page (PAL_ZERO)) == NULL)
+				return NULL;
+			*e = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		} else if (*e & PTE_PS)
+			return NULL;
+		table = ptov (PTE_ADDR (*e));
+	}
+	return &table[(va >> shift) & 0x1FF];
+}
+
+/* Maps the HPGSIZE bytes at user virtual address UPAGE to the
+ * physically contiguous frames at kernel virtual address KPAGE with
+ * a single 2 MB page-directory entry.  Both must be HPGSIZE-aligned,
+ * and nothing in the range may be mapped.  KPAGE should come from
+ * palloc_get_huge_page().  Returns true if successful, false if the
+ * range is in use or memory allocation failed. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT (((uint64_t) upage & HPGMASK) == 0);
+	ASSERT (((uint64_t) kpage & HPGMASK) == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pml4_entry_walk (pml4, (uint64_t) upage, PDXSHIFT, true);
+	if (pde == NULL)
+		return false;
+
+	uint64_t *pt = NULL;
+	if (*pde & PTE_P) {
+		/* A leftover page table may be reused for the huge page
+		 * only if none of its entries is present. */
+		if (*pde & PTE_PS)
+			return false;
+		pt = ptov (PTE_ADDR (*pde));
+		for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+			if (pt[i] & PTE_P)
+				return false;
+	}
+
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	if (pt != NULL) {
+		/* The CPU may still cache the old directory entry, and a
+		 * walk through it would read the freed page.  Drop it before
+		 * the page table goes back to the allocator. */
+		flush_all (pml4);
+		palloc_free_page (pt);
+	}
+	huge_in_use++;
+	huge_mapped++;
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
@@ -255,13 +517,84 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 
 	pte = pml4e_walk (pml4, (uint64_t) upage, false);
 
+	/* Only UPAGE goes away, so a huge page around it is split. */
+	if (pte != NULL && (*pte & PTE_PS) != 0) {
+		pte = pml4e_walk (pml4, (uint64_t) upage, true);
+		if (pte == NULL)
+			PANIC ("pml4_clear_page: cannot split huge page");
+	}
+
+	if (pte != NULL && (*pte & PTE_P) != 0) {
+		*pte &= ~PTE_P;
+		flush_page (pml4, upage);
+	}
+}
+
+/* Starts a batch of unmappings in PML4. */
+void
+mmu_gather_init (struct mmu_gather *tlb, uint64_t *pml4) {
+	tlb->pml4 = pml4;
+	tlb->va_cnt = 0;
+	tlb->page_cnt = 0;
+}
+
+/* Invalidates the PTEs cleared so far in TLB, then frees the pages
+ * queued so far. */
+static void
+mmu_gather_flush (struct mmu_gather *tlb) {
+	if (tlb->va_cnt > MMU_GATHER_VAS) {
+		flush_all (tlb->pml4);
+		gather_full++;
+	} else if (tlb->va_cnt > 0) {
+		for (size_t i = 0; i < tlb->va_cnt; i++)
+			flush_page (tlb->pml4, tlb->vas[i]);
+		gather_flushes++;
+	}
+	gather_pages += tlb->va_cnt;
+	tlb->va_cnt = 0;
+
+	palloc_free_pages (tlb->pages, tlb->page_cnt);
+	tlb->page_cnt = 0;
+}
+
+/* Like pml4_clear_page(), but leaves the TLB entry for UPAGE to be
+ * invalidated by the next flush of TLB. */
+void
+mmu_gather_clear_page (struct mmu_gather *tlb, void *upage) {
+	uint64_t *pte;
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	pte = pml4e_walk (tlb->pml4, (uint64_t) upage, false);
+	if (pte != NULL && (*pte & PTE_PS) != 0) {
+		pte = pml4e_walk (tlb->pml4, (uint64_t) upage, true);
+		if (pte == NULL)
+			PANIC ("mmu_gather_clear_page: cannot split huge page");
+	}
+
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		if (tlb->va_cnt < MMU_GATHER_VAS)
+			tlb->vas[tlb->va_cnt] = upage;
+		tlb->va_cnt++;
 	}
 }
 
+/* Frees PAGE, obtained from palloc_get_page(), once the PTEs
+ * cleared in TLB have been flushed. */
+void
+mmu_gather_free_page (struct mmu_gather *tlb, void *page) {
+	tlb->pages[tlb->page_cnt++] = page;
+	if (tlb->page_cnt == MMU_GATHER_PAGES)
+		mmu_gather_flush (tlb);
+}
+
+/* Ends the batch TLB, flushing and freeing whatever is left. */
+void
+mmu_gather_finish (struct mmu_gather *tlb) {
+	mmu_gather_flush (tlb);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
@@ -283,8 +616,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		flush_page (pml4, vpage);
 	}
 }
 
@@ -309,7 +641,19 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		flush_page (pml4, vpage);
 	}
 }
+
+/* Prints huge page, PCID and batched unmapping statistics. */
+void
+pml4_print_stats (void) {
+	printf ("Huge pages: %zu in use (%zu kB), %zu mapped, %zu split\n",
+			huge_in_use, huge_in_use * (HPGSIZE / 1024), huge_mapped,
+			huge_split);
+	if (pcid_enabled)
+		printf ("PCID: %zu address space switches, %zu TLB flushes\n",
+				pcid_switches, pcid_flushes);
+	printf ("Unmap batches: %zu pages, %zu ranged flushes, %zu full flushes\n",
+			gather_pages, gather_flushes, gather_full);
+}
@@ -0,0 +1,152 @@
+#include "threads/mprof.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+
+/* Kernel heap profiler.
+
+   With the -mprof option, malloc() puts a small header in front of
+   every block.  The header names the "site" that made the
+   allocation: the caller's return address together with the size
+   class the request fell in.  For each site the profiler keeps
+   the number of allocations and frees, and the bytes requested in
+   total, now live, and live at the peak.  The "mprof" action
+   prints the sites that hold the most live memory.  A site that
+   keeps gaining live bytes is a leak; a site with a high
+   allocation rate is worth its own object cache.
+
+   Sites live in a fixed open-addressed table.  Once it is full,
+   new sites are merged into a single "other" entry. */
+
+/* Number of sites tracked individually. */
+#define SITE_CNT 256
+
+/* Number of sites printed by mprof_dump(). */
+#define DUMP_CNT 24
+
+/* One allocation site. */
+struct mprof_site {
+	void *caller;               /* Return address, or null if unused. */
+	size_t block_size;          /* Size of the blocks handed out. */
+	size_t allocs;              /* Number of allocations. */
+	size_t frees;               /* Number of frees. */
+	size_t total;               /* Bytes ever requested. */
+	size_t live;                /* Bytes requested and not freed. */
+	size_t peak;                /* Largest value of LIVE. */
+};
+
+bool mprof_enabled;
+
+static struct mprof_site sites[SITE_CNT];
+static struct mprof_site other;         /* Sites that did not fit. */
+static size_t site_cnt;                 /* Slots of SITES in use. */
+static size_t live_bytes, peak_bytes;   /* Over all sites. */
+
+/* Returns the site for CALLER and BLOCK_SIZE, creating it if
+   needed.  Interrupts must be off. */
+static struct mprof_site *
+lookup (void *caller, size_t block_size) {
+	size_t h = (((uintptr_t) caller >> 2) ^ (block_size * 31)) % SITE_CNT;
+	size_t i;
+
+	for (i = 0; i < SITE_CNT; i++) {
+		struct mprof_site *s = &sites[(h + i) % SITE_CNT];
+		if (s->caller == caller && s->block_size == block_size)
+			return s;
+		if (s->caller == NULL) {
+			if (site_cnt >= SITE_CNT * 3 / 4)
+				break;
+			s->caller = caller;
+			s->block_size = block_size;
+			site_cnt++;
+			return s;
+		}
+	}
+	return &other;
+}
+
+/* Records an allocation of SIZE bytes, in a block of BLOCK_SIZE
+   bytes, by the function that returns to CALLER.  Returns the
+   site to pass to mprof_free() when the block is freed. */
+struct mprof_site *
+mprof_alloc (void *caller, size_t block_size, size_t size) {
+	enum intr_level old_level = intr_disable ();
+	struct mprof_site *s = lookup (caller, block_size);
+
+	s->allocs++;
+	s->total += size;
+	s->live += size;
+	if (s->live > s->peak)
+		s->peak = s->live;
+	live_bytes += size;
+	if (live_bytes > peak_bytes)
+		peak_bytes = live_bytes;
+	intr_set_level (old_level);
+	return s;
+}
+
+/* Records that a block of SIZE bytes allocated at site S was
+   freed. */
+void
+mprof_free (struct mprof_site *s, size_t size) {
+	enum intr_level old_level = intr_disable ();
+	ASSERT (s->live >= size);
+	s->frees++;
+	s->live -= size;
+	live_bytes -= size;
+	intr_set_level (old_level);
+}
+
+/* Prints the sites with the most live bytes, and the totals. */
+void
+mprof_dump (void) {
+	struct mprof_site *top[DUMP_CNT];
+	size_t top_cnt = 0;
+	int64_t ticks = timer_ticks ();
+	size_t i;
+
+	if (!mprof_enabled) {
+		printf ("Heap profiling is off; boot with -mprof.\n");
+		return;
+	}
+
+	/* Keep the DUMP_CNT sites with the most live bytes, in
+	   descending order. */
+	enum intr_level old_level = intr_disable ();
+	for (i = 0; i <= SITE_CNT; i++) {
+		struct mprof_site *s = i < SITE_CNT ? &sites[i] : &other;
+		size_t j;
+
+		if (s->allocs == 0)
+			continue;
+		for (j = top_cnt; j > 0 && top[j - 1]->live < s->live; j--)
+			if (j < DUMP_CNT)
+				top[j] = top[j - 1];
+		if (j < DUMP_CNT) {
+			top[j] = s;
+			if (top_cnt < DUMP_CNT)
+				top_cnt++;
+		}
+	}
+	intr_set_level (old_level);
+
+	/* Counters may move on while they are printed; sites stay
+	   where they are. */
+	printf ("Kernel heap: %zu bytes live, %zu at peak, %zu sites\n",
+			live_bytes, peak_bytes, site_cnt);
+	printf ("%18s %6s %9s %9s %10s %10s %8s\n", "caller", "class",
+			"allocs", "frees", "live", "peak", "allocs/s");
+	for (i = 0; i < top_cnt; i++) {
+		struct mprof_site *s = top[i];
+		size_t rate = ticks > 0 ? s->allocs * TIMER_FREQ / ticks : 0;
+
+		if (s == &other)
+			printf ("%18s %6s", "(other)", "-");
+		else
+			printf ("%18p %6zu", s->caller, s->block_size);
+		printf (" %9zu %9zu %10zu %10zu %8zu\n", s->allocs, s->frees,
+				s->live, s->peak, rate);
+	}
+}
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -24,14 +25,72 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, pages are handed out by a binary buddy allocator.
+   A free block of order K is 2**K pages whose physical page number
+   is a multiple of 2**K, so an order-9 block is always a valid huge
+   page.  Each pool keeps one free list per order.  Allocation
+   splits the smallest block that is large enough.  Freeing merges
+   a block with its buddy for as long as the buddy is free as well.
+   Pages may be freed in any grouping, not just the one they were
+   allocated in, because a freed range is cut into aligned blocks.
+
+   The free lists are linked through a per-page array kept next to
+   the used_map rather than through the free pages themselves,
+   which are not all mapped yet when the pools are populated.  They
+   are modified with interrupts off, because the scheduler frees
+   the pages of dead threads. */
+
+#define MAX_ORDER 18		 /* Largest block: 2**18 pages (1 GB). */
+#define NO_ORDER 0xff		 /* Page does not start a free block. */
+#define NO_PAGE UINT32_MAX /* Null free list link. */
+
+/* Per-CPU page cache.  Single pages are allocated from, and freed
+   to, a small stack of pages in front of the buddy lists: a
+   "magazine", refilled and drained MAG_BATCH pages at a time.  The
+   bottom of the stack holds pages known to be zero-filled; the
+   idle thread zeroes freed pages ahead of time through
+   palloc_prezero(), so that most PAL_ZERO requests need no memset.
+   Pintos runs on one CPU, so each pool has a single magazine, and
+   like any per-CPU data it is only touched with interrupts off. */
+#define MAG_SIZE 32	 /* Pages a magazine holds. */
+#define MAG_BATCH 16 /* Pages moved in one refill or drain. */
+
+struct magazine
+{
+	size_t cnt;			   /* # of pages held. */
+	size_t zeroed;		   /* pages[0...zeroed-1] are zero-filled. */
+	void *pages[MAG_SIZE]; /* Zero-filled pages, then dirty ones. */
+	size_t hits;		   /* # of allocations served. */
+	size_t zero_hits;	   /* # of PAL_ZERO ones served pre-zeroed. */
+	size_t refills;		   /* # of refills from the buddy lists. */
+};
+
+/* Buddy allocator state of one page. */
+struct buddy_page
+{
+	union
+	{
+		struct
+		{
+			uint32_t prev, next; /* Free list links, as page indexes. */
+		};
+		void *owner; /* While allocated: see palloc_set_owner(). */
+	};
+	uint8_t order; /* Order of the free block starting here. */
+};
 
 /* A memory pool. */
 struct pool
 {
-	struct lock lock;		 /* Mutual exclusion. */
-	struct bitmap *used_map; /* Bitmap of free pages. */
-	uint8_t *base;			 /* Base of pool. */
+	struct bitmap *used_map;			   /* Bitmap of free pages. */
+	struct buddy_page *pages;			   /* Buddy state of each page. */
+	uint32_t free_list[MAX_ORDER + 1];	   /* First free block per order. */
+	size_t free_blocks[MAX_ORDER + 1];	   /* # of free blocks per order. */
+	size_t free_cnt;					   /* # of free pages. */
+	struct magazine mag;				   /* This CPU's page cache. */
+	uint8_t *base;						   /* Base of pool. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -43,6 +102,11 @@ static void
 init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool(const struct pool *, void *page);
+static size_t pool_alloc(struct pool *, size_t page_cnt);
+static void pool_free(struct pool *, size_t page_idx, size_t page_cnt);
+static void *mag_get(struct pool *, bool zero, bool *zeroed);
+static void mag_put(struct pool *, void *page);
+static void mag_drain(struct pool *, size_t page_cnt);
 
 /* multiboot info */
 struct multiboot_info
@@ -251,14 +315,14 @@ populate_pools(struct area *base_mem, struct area *ext_mem)
 			if ((uint64_t)pool_end < end)
 			{
 				page_cnt = ((uint64_t)pool_end - start) / PGSIZE;
-				bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+				pool_free(pool, page_idx, page_cnt);
 				start = (uint64_t)pool_end;
 				goto split;
 			}
 			else
 			{
 				page_cnt = ((uint64_t)end - start) / PGSIZE;
-				bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+				pool_free(pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -294,23 +358,29 @@ void *
 palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
 {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages = NULL;
+	bool zeroed = false;
 
-	lock_acquire(&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
-	lock_release(&pool->lock);
-	void *pages;
-	// merge 삼총사의 견고함을 위해 밑의 작업도 락 걸어줌.
-	lock_acquire(&pool->lock);
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
+	enum intr_level old_level = intr_disable();
+	if (page_cnt == 1)
+		pages = mag_get(pool, flags & PAL_ZERO, &zeroed);
+	if (pages == NULL)
 	{
-		pages = NULL;
+		size_t page_idx = pool_alloc(pool, page_cnt);
+		if (page_idx == BITMAP_ERROR && pool->mag.cnt > 0)
+		{
+			// 캐시에 묶여 있던 페이지까지 돌려주고 다시 시도한다.
+			mag_drain(pool, pool->mag.cnt);
+			page_idx = pool_alloc(pool, page_cnt);
+		}
+		if (page_idx != BITMAP_ERROR)
+			pages = pool->base + PGSIZE * page_idx;
 	}
+	intr_set_level(old_level);
 
 	if (pages)
 	{
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset(pages, 0, PGSIZE * page_cnt);
 	}
 	else
@@ -318,7 +388,6 @@ palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
 		if (flags & PAL_ASSERT)
 			PANIC("palloc_get: out of pages");
 	}
-	lock_release(&pool->lock);
 	return pages;
 }
 
@@ -335,6 +404,17 @@ palloc_get_page(enum palloc_flags flags)
 	return palloc_get_multiple(flags, 1);
 }
 
+/* Obtains HPGSIZE / PGSIZE contiguous free pages starting on a
+   HPGSIZE boundary, so that they can be mapped as one huge page.
+   FLAGS are as for palloc_get_multiple().  The pages may later be
+   freed together or one at a time. */
+void *
+palloc_get_huge_page(enum palloc_flags flags)
+{
+	/* Buddy blocks are aligned to their own size. */
+	return palloc_get_multiple(flags, HPGSIZE / PGSIZE);
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void palloc_free_multiple(void *pages, size_t page_cnt)
 {
@@ -357,8 +437,13 @@ void palloc_free_multiple(void *pages, size_t page_cnt)
 #ifndef NDEBUG
 	memset(pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	enum intr_level old_level = intr_disable();
 	ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+	if (page_cnt == 1)
+		mag_put(pool, pages);
+	else
+		pool_free(pool, page_idx, page_cnt);
+	intr_set_level(old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -367,6 +452,88 @@ void palloc_free_page(void *page)
 	palloc_free_multiple(page, 1);
 }
 
+/* Frees the PAGE_CNT single pages in PAGES, which need not be
+   contiguous.  Each run of pages that follow one another in the
+   array and in memory, within one pool, is released with one
+   bitmap update. */
+void palloc_free_pages(void *pages[], size_t page_cnt)
+{
+	size_t i = 0;
+
+	while (i < page_cnt)
+	{
+		size_t run = 1;
+		bool kernel = page_from_pool(&kernel_pool, pages[i]);
+		while (i + run < page_cnt && pages[i + run] == pages[i] + run * PGSIZE && page_from_pool(&kernel_pool, pages[i + run]) == kernel)
+			run++;
+		palloc_free_multiple(pages[i], run);
+		i += run;
+	}
+}
+
+/* Returns the pool that PAGE belongs to. */
+static struct pool *
+page_to_pool(const void *page)
+{
+	if (page_from_pool(&kernel_pool, (void *)page))
+		return &kernel_pool;
+	else if (page_from_pool(&user_pool, (void *)page))
+		return &user_pool;
+	NOT_REACHED();
+}
+
+/* Records OWNER as the owner of PAGE, which must be allocated, so
+   that palloc_get_owner() can find it again.  A subpage allocator
+   uses this to find the descriptor of any page in one of its
+   multi-page blocks.  The record goes away when PAGE is freed. */
+void palloc_set_owner(void *page, void *owner)
+{
+	struct pool *pool = page_to_pool(page);
+	size_t page_idx = pg_no(page) - pg_no(pool->base);
+
+	ASSERT(bitmap_test(pool->used_map, page_idx));
+	pool->pages[page_idx].owner = owner;
+}
+
+/* Returns the owner recorded for allocated page PAGE. */
+void *
+palloc_get_owner(const void *page)
+{
+	struct pool *pool = page_to_pool(page);
+	return pool->pages[pg_no(page) - pg_no(pool->base)].owner;
+}
+
+/* Prints the free pages of POOL, called NAME, by block order. */
+static void
+print_pool_stats(const char *name, struct pool *pool)
+{
+	struct magazine *mag = &pool->mag;
+
+	printf("%s pool: %zu free pages;", name, pool->free_cnt);
+	for (int order = 0; order <= MAX_ORDER; order++)
+		if (pool->free_blocks[order] != 0)
+			printf(" %zu@%d", pool->free_blocks[order], order);
+	printf("\n");
+	printf("%s page cache: %zu pages (%zu zeroed), %zu hits (%zu pre-zeroed), %zu refills\n",
+		   name, mag->cnt, mag->zeroed, mag->hits, mag->zero_hits, mag->refills);
+}
+
+/* Prints page allocator statistics: for each pool, how many free
+   blocks of each order ("COUNT@ORDER") it has, and how its page
+   cache fared.  Many low-order blocks and few high-order ones mean
+   a fragmented pool. */
+void palloc_print_stats(void)
+{
+	print_pool_stats("Kernel", &kernel_pool);
+	print_pool_stats("User", &user_pool);
+}
+
+/* Returns the number of pages in the user pool. */
+size_t palloc_user_pages(void)
+{
+	return bitmap_size(user_pool.used_map);
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end)
@@ -376,15 +543,251 @@ init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end)
 	   and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP(bitmap_buf_size(pgcnt), PGSIZE) * PGSIZE;
+	size_t buddy_pages = DIV_ROUND_UP(pgcnt * sizeof(struct buddy_page), PGSIZE) * PGSIZE;
 
-	lock_init(&p->lock);
+	ASSERT(pgcnt < NO_PAGE);
 	p->used_map = bitmap_create_in_buf(pgcnt, *bm_base, bm_pages);
+	p->pages = *bm_base + bm_pages;
 	p->base = (void *)start;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	for (size_t i = 0; i < pgcnt; i++)
+		p->pages[i].order = NO_ORDER;
+	for (int order = 0; order <= MAX_ORDER; order++)
+	{
+		p->free_list[order] = NO_PAGE;
+		p->free_blocks[order] = 0;
+	}
+	p->free_cnt = 0;
+	memset(&p->mag, 0, sizeof p->mag);
 
-	*bm_base += bm_pages;
+	*bm_base += bm_pages + buddy_pages;
+}
+
+/* Returns the physical page number of page PAGE_IDX of POOL.
+   Block alignment is decided on it, not on PAGE_IDX, so that
+   blocks are aligned in physical memory whatever the pool's base. */
+static size_t
+pool_pfn(const struct pool *pool, size_t page_idx)
+{
+	return pg_no(vtop(pool->base)) + page_idx;
+}
+
+/* Puts the free block of ORDER at PAGE_IDX on POOL's free list. */
+static void
+block_push(struct pool *pool, size_t page_idx, int order)
+{
+	struct buddy_page *bp = &pool->pages[page_idx];
+	uint32_t head = pool->free_list[order];
+
+	bp->order = order;
+	bp->prev = NO_PAGE;
+	bp->next = head;
+	if (head != NO_PAGE)
+		pool->pages[head].prev = page_idx;
+	pool->free_list[order] = page_idx;
+	pool->free_blocks[order]++;
+}
+
+/* Takes the free block at PAGE_IDX off POOL's free list. */
+static void
+block_remove(struct pool *pool, size_t page_idx)
+{
+	struct buddy_page *bp = &pool->pages[page_idx];
+
+	if (bp->prev != NO_PAGE)
+		pool->pages[bp->prev].next = bp->next;
+	else
+		pool->free_list[bp->order] = bp->next;
+	if (bp->next != NO_PAGE)
+		pool->pages[bp->next].prev = bp->prev;
+	pool->free_blocks[bp->order]--;
+	bp->order = NO_ORDER;
+}
+
+/* Frees the aligned block of ORDER at PAGE_IDX, merging it with
+   its buddy as long as the buddy is a free block of the same
+   order. */
+static void
+block_free(struct pool *pool, size_t page_idx, int order)
+{
+	size_t pgcnt = bitmap_size(pool->used_map);
+	size_t base_pfn = pool_pfn(pool, 0);
+
+	while (order < MAX_ORDER)
+	{
+		size_t buddy_pfn = pool_pfn(pool, page_idx) ^ ((size_t)1 << order);
+		if (buddy_pfn < base_pfn || buddy_pfn - base_pfn >= pgcnt)
+			break;
+		size_t buddy = buddy_pfn - base_pfn;
+		if (pool->pages[buddy].order != order)
+			break;
+		block_remove(pool, buddy);
+		if (buddy < page_idx)
+			page_idx = buddy;
+		order++;
+	}
+	block_push(pool, page_idx, order);
+}
+
+/* Marks the PAGE_CNT pages at PAGE_IDX of POOL free, cutting them
+   into the largest aligned blocks that fit.  Interrupts must be
+   off, or the pools not yet in use. */
+static void
+pool_free(struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+	bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+	pool->free_cnt += page_cnt;
+	while (page_cnt > 0)
+	{
+		size_t pfn = pool_pfn(pool, page_idx);
+		int order = 0;
+		while (order < MAX_ORDER && pfn % ((size_t)2 << order) == 0 && ((size_t)2 << order) <= page_cnt)
+			order++;
+		block_free(pool, page_idx, order);
+		page_idx += (size_t)1 << order;
+		page_cnt -= (size_t)1 << order;
+	}
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR.  The smallest block of at
+   least PAGE_CNT pages is split down to size, and pages past
+   PAGE_CNT are given back.  Interrupts must be off. */
+static size_t
+pool_alloc(struct pool *pool, size_t page_cnt)
+{
+	int want = 0;
+	while (((size_t)1 << want) < page_cnt)
+		if (++want > MAX_ORDER)
+			return BITMAP_ERROR;
+
+	int order = want;
+	while (order <= MAX_ORDER && pool->free_list[order] == NO_PAGE)
+		order++;
+	if (order > MAX_ORDER)
+		return BITMAP_ERROR;
+
+	size_t page_idx = pool->free_list[order];
+	block_remove(pool, page_idx);
+	while (order > want)
+	{
+		order--;
+		block_push(pool, page_idx + ((size_t)1 << order), order);
+	}
+
+	pool->free_cnt -= (size_t)1 << want;
+	bitmap_set_multiple(pool->used_map, page_idx, (size_t)1 << want, true);
+	if (page_cnt < ((size_t)1 << want))
+		pool_free(pool, page_idx + page_cnt, ((size_t)1 << want) - page_cnt);
+	return page_idx;
+}
+
+/* Takes a page from POOL's magazine, refilling it from the buddy
+   lists if it is empty.  If ZERO, a zero-filled page is preferred
+   and *ZEROED tells whether one was found.  Returns a null pointer
+   if no page could be had.  Interrupts must be off. */
+static void *
+mag_get(struct pool *pool, bool zero, bool *zeroed)
+{
+	struct magazine *mag = &pool->mag;
+	void *page;
+
+	if (mag->cnt == 0)
+	{
+		size_t page_cnt = MAG_BATCH;
+		size_t page_idx = pool_alloc(pool, page_cnt);
+		if (page_idx == BITMAP_ERROR)
+			return NULL;
+		// 낮은 주소의 페이지가 먼저 나가도록 거꾸로 쌓는다.
+		while (page_cnt-- > 0)
+			mag->pages[mag->cnt++] = pool->base + PGSIZE * (page_idx + page_cnt);
+		mag->refills++;
+	}
+
+	if (zero && mag->zeroed > 0)
+	{
+		// 0으로 채워진 구간의 마지막 페이지를 꺼내고 그 자리는 맨 위 페이지로 메운다.
+		page = mag->pages[--mag->zeroed];
+		mag->pages[mag->zeroed] = mag->pages[--mag->cnt];
+		mag->zero_hits++;
+		*zeroed = true;
+	}
+	else
+	{
+		page = mag->pages[--mag->cnt];
+		if (mag->zeroed > mag->cnt)
+			mag->zeroed = mag->cnt;
+	}
+	mag->hits++;
+	return page;
+}
+
+/* Puts PAGE into POOL's magazine, first draining it if it is full.
+   Interrupts must be off. */
+static void
+mag_put(struct pool *pool, void *page)
+{
+	struct magazine *mag = &pool->mag;
+
+	if (mag->cnt == MAG_SIZE)
+		mag_drain(pool, MAG_BATCH);
+	mag->pages[mag->cnt++] = page;
+}
+
+/* Gives the PAGE_CNT pages on top of POOL's magazine back to the
+   buddy lists.  Dirty pages go first.  Interrupts must be off. */
+static void
+mag_drain(struct pool *pool, size_t page_cnt)
+{
+	struct magazine *mag = &pool->mag;
+
+	ASSERT(page_cnt <= mag->cnt);
+	while (page_cnt-- > 0)
+	{
+		void *page = mag->pages[--mag->cnt];
+		pool_free(pool, pg_no(page) - pg_no(pool->base), 1);
+	}
+	if (mag->zeroed > mag->cnt)
+		mag->zeroed = mag->cnt;
+}
+
+/* Zeroes one dirty page of POOL's magazine, if it has one.  Returns
+   true if a page was zeroed. */
+static bool
+mag_prezero(struct pool *pool)
+{
+	struct magazine *mag = &pool->mag;
+	void *page = NULL;
+
+	enum intr_level old_level = intr_disable();
+	if (mag->cnt > mag->zeroed)
+		page = mag->pages[--mag->cnt];
+	intr_set_level(old_level);
+	if (page == NULL)
+		return false;
+
+	memset(page, 0, PGSIZE);
+
+	old_level = intr_disable();
+	if (mag->cnt == MAG_SIZE)
+		mag_drain(pool, MAG_BATCH);
+	// 0으로 채운 페이지는 아래쪽 구간의 끝에 넣는다.
+	mag->pages[mag->cnt++] = mag->pages[mag->zeroed];
+	mag->pages[mag->zeroed++] = page;
+	intr_set_level(old_level);
+	return true;
+}
+
+/* Zeroes the dirty pages held in the page caches, so that later
+   PAL_ZERO requests can skip the memset.  Called by the idle
+   thread with interrupts on; pages are taken out of the cache while
+   they are zeroed, so this may be interrupted at any point. */
+void palloc_prezero(void)
+{
+	while (mag_prezero(&kernel_pool) || mag_prezero(&user_pool))
+		continue;
 }
 
 /* Returns true if PAGE was allocated from POOL,
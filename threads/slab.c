@@ -0,0 +1,287 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   A cache hands out objects of one size.  It takes single pages,
+   called "slabs", from the page allocator and carves each into as
+   many objects as fit after a small header.  Slabs are kept on
+   three lists: full, partially used, and empty.  An allocation
+   takes an object from a partial slab whenever there is one, so
+   that live objects stay packed into few pages.  When the last
+   object of a slab is freed, the slab is given back to the page
+   allocator, unless it is the cache's only empty slab.
+
+   Unlike malloc(), a cache does not round object sizes up to a
+   power of 2, so a 40-byte structure costs 40 bytes rather than
+   64.
+
+   The constructor, if any, runs once per object, when its slab is
+   carved.  Objects keep their constructed state while they are
+   free: the free list lives in an array of indexes in the slab
+   header, not in the objects.  Whoever frees an object must
+   therefore hand it back in its constructed state.
+
+   A page rarely divides evenly into objects.  The bytes left over
+   are used to "color" the slabs: successive slabs start their first
+   object at successive multiples of the cache line size.  That way
+   the objects with the same index in different slabs do not all
+   compete for the same cache sets. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab0bec
+
+/* Cache line size assumed for coloring. */
+#define CACHE_LINE 64
+
+/* Null free list link. */
+#define NO_OBJ UINT16_MAX
+
+/* Object cache. */
+struct kmem_cache {
+	char name[16];              /* Name, for statistics. */
+	size_t obj_size;            /* Size of each object in bytes. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	size_t hdr_size;            /* Bytes of slab header. */
+	size_t color_max;           /* Largest color offset. */
+	size_t color_next;          /* Color offset of the next slab. */
+	kmem_ctor *ctor;            /* Constructor, or null. */
+	struct list full;           /* Slabs with no free object. */
+	struct list partial;        /* Slabs with some free objects. */
+	struct list empty;          /* Slabs with no object in use. */
+	struct lock lock;           /* Lock. */
+	struct list_elem elem;      /* Element in cache_list. */
+
+	/* Statistics. */
+	size_t slab_cnt;            /* Slabs held. */
+	size_t in_use;              /* Objects handed out. */
+	size_t allocs;              /* Calls to kmem_cache_alloc(). */
+	size_t frees;               /* Calls to kmem_cache_free(). */
+};
+
+/* Slab header, at the start of each slab's page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in one of the cache's lists. */
+	uint8_t *objs;              /* First object. */
+	size_t in_use;              /* Objects handed out. */
+	uint16_t free_head;         /* First free object, or NO_OBJ. */
+	uint16_t next_free[];       /* Free list links, one per object. */
+};
+
+/* Every cache, for statistics. */
+static struct list cache_list;
+static struct lock cache_list_lock;
+
+/* Initializes the slab allocator. */
+void
+kmem_init (void) {
+	list_init (&cache_list);
+	lock_init (&cache_list_lock);
+}
+
+/* Creates and returns a cache, called NAME, of SIZE-byte objects.
+   If CTOR is nonnull, it is called on each object once, when
+   the object is first carved out of a new slab.
+   Returns a null pointer if memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor) {
+	struct kmem_cache *c;
+	size_t n;
+
+	ASSERT (size > 0);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		return NULL;
+
+	strlcpy (c->name, name, sizeof c->name);
+	c->obj_size = ROUND_UP (size, sizeof (void *));
+	c->ctor = ctor;
+
+	/* Fit as many objects as possible after the header and its
+	   free list links. */
+	n = (PGSIZE - sizeof (struct slab)) / (c->obj_size + sizeof (uint16_t));
+	while (n > 0 && ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+				sizeof (void *)) + n * c->obj_size > PGSIZE)
+		n--;
+	ASSERT (n > 0 && n < NO_OBJ);
+	c->objs_per_slab = n;
+	c->hdr_size = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+			sizeof (void *));
+	c->color_max = ROUND_DOWN (PGSIZE - c->hdr_size - n * c->obj_size,
+			CACHE_LINE);
+	c->color_next = 0;
+
+	list_init (&c->full);
+	list_init (&c->partial);
+	list_init (&c->empty);
+	lock_init (&c->lock);
+	c->slab_cnt = c->in_use = c->allocs = c->frees = 0;
+
+	lock_acquire (&cache_list_lock);
+	list_push_back (&cache_list, &c->elem);
+	lock_release (&cache_list_lock);
+	return c;
+}
+
+/* Carves a new slab for cache C and puts it on C's empty list.
+   Returns false if no page is available. */
+static bool
+slab_grow (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	size_t i;
+
+	if (s == NULL)
+		return false;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->objs = (uint8_t *) s + c->hdr_size + c->color_next;
+	s->in_use = 0;
+	s->free_head = 0;
+	for (i = 0; i < c->objs_per_slab; i++) {
+		s->next_free[i] = i + 1 < c->objs_per_slab ? i + 1 : NO_OBJ;
+		if (c->ctor != NULL)
+			c->ctor (s->objs + i * c->obj_size);
+	}
+
+	c->color_next = c->color_next + CACHE_LINE <= c->color_max
+		? c->color_next + CACHE_LINE : 0;
+	c->slab_cnt++;
+	list_push_back (&c->empty, &s->elem);
+	return true;
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	void *obj;
+
+	lock_acquire (&c->lock);
+
+	/* Prefer a partial slab, then an empty one, then a new one. */
+	if (!list_empty (&c->partial))
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+	else {
+		if (list_empty (&c->empty) && !slab_grow (c)) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		s = list_entry (list_front (&c->empty), struct slab, elem);
+	}
+
+	ASSERT (s->free_head != NO_OBJ);
+	obj = s->objs + s->free_head * c->obj_size;
+	s->free_head = s->next_free[s->free_head];
+
+	/* Move the slab to the list that now describes it. */
+	if (s->in_use++ == 0 || s->free_head == NO_OBJ) {
+		list_remove (&s->elem);
+		list_push_front (s->free_head == NO_OBJ ? &c->full : &c->partial,
+				&s->elem);
+	}
+
+	c->in_use++;
+	c->allocs++;
+	lock_release (&c->lock);
+	return obj;
+}
+
+/* Returns the slab that object OBJ of cache C is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	/* Check that the slab is valid. */
+	ASSERT (s != NULL);
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+
+	/* Check that the object is properly aligned for the slab. */
+	ASSERT ((uint8_t *) obj >= s->objs);
+	ASSERT (((uint8_t *) obj - s->objs) % c->obj_size == 0);
+
+	return s;
+}
+
+/* Returns object OBJ, which must have been obtained from cache C
+   with kmem_cache_alloc(), to C.  A null OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+	size_t idx;
+
+	if (obj == NULL)
+		return;
+
+	s = obj_to_slab (c, obj);
+	idx = ((uint8_t *) obj - s->objs) / c->obj_size;
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs, unless
+	   it has to stay constructed. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->obj_size);
+#endif
+
+	lock_acquire (&c->lock);
+
+	bool was_full = s->free_head == NO_OBJ;
+	s->next_free[idx] = s->free_head;
+	s->free_head = idx;
+	c->in_use--;
+	c->frees++;
+
+	if (--s->in_use == 0) {
+		/* Keep one empty slab around to absorb alloc/free churn,
+		   and give any other back to the page allocator. */
+		list_remove (&s->elem);
+		if (list_empty (&c->empty))
+			list_push_front (&c->empty, &s->elem);
+		else {
+			c->slab_cnt--;
+			s->magic = 0;
+			palloc_free_page (s);
+		}
+	} else if (was_full) {
+		list_remove (&s->elem);
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	lock_release (&c->lock);
+}
+
+/* Prints statistics for every cache: objects in use, slabs
+   held, the share of the slabs' memory in use, and the number of
+   allocations and frees. */
+void
+kmem_print_stats (void) {
+	struct list_elem *e;
+
+	lock_acquire (&cache_list_lock);
+	for (e = list_begin (&cache_list); e != list_end (&cache_list);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		size_t bytes = c->slab_cnt * PGSIZE;
+		size_t used = c->in_use * c->obj_size;
+
+		printf ("Slab %s: %zu objects of %zu bytes in %zu slabs "
+				"(%zu%% used), %zu allocs, %zu frees\n",
+				c->name, c->in_use, c->obj_size, c->slab_cnt,
+				bytes != 0 ? used * 100 / bytes : 0, c->allocs, c->frees);
+	}
+	lock_release (&cache_list_lock);
+}
@@ -474,6 +474,9 @@ idle(void *idle_started_ UNUSED)
 
 	for (;;)
 	{
+		/* Use the spare time to zero cached free pages. */
+		palloc_prezero();
+
 		/* Let someone else run. */
 		intr_disable();
 		thread_block();
@@ -175,6 +175,8 @@ __do_fork(void *aux)
 		goto error;
 	process_activate(current);
 #ifdef VM
+	// 자식도 부모의 rss 상한 안에서 페이지를 복사한다.
+	current->rss_limit = parent->rss_limit;
 	supplemental_page_table_init(&current->spt);
 	if (!supplemental_page_table_copy(&current->spt, &parent->spt))
 	{
@@ -196,6 +198,9 @@ __do_fork(void *aux)
 			current->fd_table[i] = file_duplicate(parent->fd_table[i]);
 		}
 	}
+#ifdef VM
+	shm_fork(parent, current);
+#endif
 	// printf("exit_status in fork : %d\n", current->exit_status);
 
 	// fork 완료되면 깨우기
@@ -229,6 +234,10 @@ int process_exec(void *f_name)
 
 	/* We first kill the current context */
 	process_cleanup();
+#ifdef VM
+	// 새 실행 파일은 빈 테이블에서 시작한다. ksmd 목록에도 다시 오른다.
+	supplemental_page_table_init(&thread_current()->spt);
+#endif
 
 	/* And then load the binary */
 	success = load(file_name, &_if);
@@ -298,6 +307,9 @@ void process_exit(void)
 		file_close(cur->fd_table[i]);
 		cur->fd_table[i] = NULL;
 	}
+#ifdef VM
+	shm_close_all();
+#endif
 	file_close(cur->running); // 현재 실행 중인 파일을 닫는다.
 	process_cleanup();
 	// printf("exit_status in exit1 : %d\n", cur->exit_status);
@@ -795,40 +807,13 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
 	ASSERT(pg_ofs(upage) == 0);
 	ASSERT(ofs % PGSIZE == 0);
-	while (read_bytes > 0 || zero_bytes > 0)
-	{
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct load_info *aux = malloc(sizeof(struct load_info));
-		if (aux == NULL)
-		{
-			return false;
-		}
-		aux->file = file;
-		aux->offset = ofs;
-		aux->read_bytes = page_read_bytes;
-		aux->zero_bytes = page_zero_bytes;
-		aux->writable = writable;
-		if (!vm_alloc_page_with_initializer(VM_ANON, upage,
-											writable, lazy_load_segment, aux))
-		{
-			free(aux);
-			return false;
-		}
-
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-		// 승우님 추가
-		ofs += page_read_bytes;
-	}
-	return true;
+	// 세그먼트 전체를 구역 하나로 기록하고, 페이지는 처음 폴트 날 때 만든다.
+	// 읽기 전용 세그먼트(코드)는 같은 실행 파일을 띄운 프로세스끼리 공유한다.
+	enum vm_type type = writable ? VM_ANON : VM_FILE | VM_TEXT;
+	vm_initializer *init = writable ? lazy_load_segment : NULL;
+	return region_create(&thread_current()->spt, upage, read_bytes + zero_bytes, type,
+						 writable, file, ofs, read_bytes, init) != NULL;
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
@@ -842,8 +827,8 @@ setup_stack(struct intr_frame *if_)
 	// bool success = false;
 	void *stack_bottom = (void *)(((uint8_t *)USER_STACK) - PGSIZE);
 	// printf("stack_bottom : %p\n", stack_bottom);
-	// 주어진 stack_bottom 주소에 해당하는 페이지를 현재 스레드 페이지 테이블에 할당하고 메모리에 매핑
-	if (!vm_alloc_page(VM_ANON | VM_STACK, stack_bottom, true))
+	// 스택이 자랄 구역을 잡아 두고, 맨 위 페이지만 바로 올린다. 나머지는 폴트 때 만든다.
+	if (region_create_stack(&thread_current()->spt) == NULL)
 	{
 		return false;
 	}
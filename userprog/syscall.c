@@ -14,6 +14,9 @@
 #include "userprog/process.h"
 #include "threads/palloc.h"
 #include "vm/vm.h"
+#include "vm/madvise.h"
+#include "vm/mlock.h"
+#include "vm/memstat.h"
 void syscall_entry(void);
 void syscall_handler(struct intr_frame *);
 void check_ptr(const void *ptr);
@@ -33,6 +36,13 @@ void sys_seek(int fd, unsigned position);
 unsigned sys_tell(int fd);
 void *sys_mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void sys_munmap(void *addr);
+int sys_madvise(void *addr, size_t length, int advice);
+int sys_mlock(void *addr, size_t length);
+int sys_munlock(void *addr, size_t length);
+int sys_shm_create(size_t size);
+int sys_memstat(pid_t pid, struct memstat *st);
+int sys_set_rss_limit(pid_t pid, size_t pages);
+int sys_faultstat(pid_t pid, struct faultstat *st);
 /* System call.
  *
  * Previously system call services was handled by the interrupt handler
@@ -169,6 +179,41 @@ void syscall_handler(struct intr_frame *f)
 		sys_munmap(f->R.rdi);
 	}
 	break;
+	case SYS_MADVISE:
+	{
+		f->R.rax = sys_madvise((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+	}
+	break;
+	case SYS_MLOCK:
+	{
+		f->R.rax = sys_mlock((void *)f->R.rdi, f->R.rsi);
+	}
+	break;
+	case SYS_MUNLOCK:
+	{
+		f->R.rax = sys_munlock((void *)f->R.rdi, f->R.rsi);
+	}
+	break;
+	case SYS_SHM_CREATE:
+	{
+		f->R.rax = sys_shm_create(f->R.rdi);
+	}
+	break;
+	case SYS_MEMSTAT:
+	{
+		f->R.rax = sys_memstat(f->R.rdi, (void *)f->R.rsi);
+	}
+	break;
+	case SYS_SET_RSS_LIMIT:
+	{
+		f->R.rax = sys_set_rss_limit(f->R.rdi, f->R.rsi);
+	}
+	break;
+	case SYS_FAULTSTAT:
+	{
+		f->R.rax = sys_faultstat(f->R.rdi, (void *)f->R.rsi);
+	}
+	break;
 	default:
 		thread_exit();
 	}
@@ -250,6 +295,11 @@ int sys_open(const char *file)
 int sys_close(int fd)
 {
 	struct thread *t = thread_current();
+	if (shm_is_fd(fd))
+	{
+		shm_close(fd);
+		return;
+	}
 	if (!is_user_vaddr(fd) || fd >= 32 || fd < 0)
 	{
 		return;
@@ -261,6 +311,37 @@ int sys_close(int fd)
 	}
 }
 
+/* Read SIZE bytes from FILE into BUFFER or, if TO_FILE, write them
+ * from BUFFER to FILE, PIN_MAX_PAGES pages at a time.  The frames
+ * under each piece are pinned for the length of the transfer so
+ * that they are not evicted halfway through it. */
+static int
+pinned_io(struct file *file, void *buffer, unsigned size, bool to_file)
+{
+	struct frame *pins[PIN_MAX_PAGES];
+	int total = 0;
+	while (size > 0)
+	{
+		unsigned chunk = PIN_MAX_PAGES * PGSIZE - pg_ofs(buffer);
+		if (chunk > size)
+		{
+			chunk = size;
+		}
+		// 파일에서 읽으면 사용자 버퍼에 쓰게 되므로 쓰기용으로 고정한다.
+		size_t cnt = vm_pin_range(buffer, chunk, !to_file, pins);
+		int n = to_file ? file_write(file, buffer, chunk) : file_read(file, buffer, chunk);
+		vm_unpin_frames(pins, cnt);
+		total += n;
+		if (n != (int)chunk)
+		{
+			break;
+		}
+		buffer += n;
+		size -= n;
+	}
+	return total;
+}
+
 int sys_read(int fd, void *buffer, unsigned size)
 {
 	// writecode2 통과 코드
@@ -282,7 +363,7 @@ int sys_read(int fd, void *buffer, unsigned size)
 	struct thread *t = thread_current();
 	if (t->fd_table[fd] != NULL)
 	{
-		return file_read(t->fd_table[fd], buffer, size);
+		return pinned_io(t->fd_table[fd], buffer, size, false);
 	}
 	return -1;
 }
@@ -303,7 +384,7 @@ int sys_write(int fd, const void *buffer, unsigned size)
 	else
 	{
 
-		return file_write(t->fd_table[fd], buffer, size);
+		return pinned_io(t->fd_table[fd], (void *)buffer, size, true);
 	}
 }
 
@@ -364,6 +445,15 @@ void *sys_mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 {
 
 	struct thread *t = thread_current();
+	// 공유 메모리 객체는 항상 공유로 매핑한다.
+	if (shm_is_fd(fd))
+	{
+		if (addr == NULL || length == 0 || is_kernel_vaddr(length) || pg_ofs(addr) != 0 || is_kernel_vaddr(addr))
+		{
+			return NULL;
+		}
+		return shm_mmap(addr, length, writable & ~MAP_SHARED, fd, offset);
+	}
 	if (fd < 3 || fd > 32)
 	{
 		sys_exit(-1);
@@ -373,9 +463,48 @@ void *sys_mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 	{
 		return NULL;
 	}
+	if (writable & MAP_SHARED)
+	{
+		return shm_mmap_file(addr, length, writable & ~MAP_SHARED, t->fd_table[fd], offset);
+	}
 	return do_mmap(addr, length, writable, t->fd_table[fd], offset);
 }
 void sys_munmap(void *addr)
 {
 	do_munmap(addr);
-}
\ No newline at end of file
+}
+int sys_madvise(void *addr, size_t length, int advice)
+{
+	// 주소 범위 검사는 do_madvise에서 한다. 잘못된 범위는 -1을 돌려줄 뿐 프로세스를 죽이지 않는다.
+	return do_madvise(addr, length, advice);
+}
+int sys_mlock(void *addr, size_t length)
+{
+	return do_mlock(addr, length);
+}
+int sys_munlock(void *addr, size_t length)
+{
+	return do_munlock(addr, length);
+}
+int sys_shm_create(size_t size)
+{
+	return shm_create(size);
+}
+int sys_memstat(pid_t pid, struct memstat *st)
+{
+	// 구조체가 페이지 경계에 걸칠 수 있으니 끝도 확인한다.
+	check_ptr(st);
+	check_ptr((char *)st + sizeof *st - 1);
+	return do_memstat(pid, st);
+}
+int sys_set_rss_limit(pid_t pid, size_t pages)
+{
+	return do_set_rss_limit(pid, pages);
+}
+int sys_faultstat(pid_t pid, struct faultstat *st)
+{
+	// 구조체가 페이지 경계에 걸칠 수 있으니 끝도 확인한다.
+	check_ptr(st);
+	check_ptr((char *)st + sizeof *st - 1);
+	return do_faultstat(pid, st);
+}
@@ -0,0 +1,172 @@
+/* aging.c: Working-set estimation for eviction.
+ *
+ * Every resident page has an 8-bit age.  A kernel thread, aged,
+ * wakes up every aging_interval_ms milliseconds and, for each
+ * resident page of every process, shifts the age right by one and
+ * moves the page's accessed bit into the top bit, clearing the
+ * accessed bit.  The age thus records in which of the last eight
+ * periods the page was used, the most recent one first, and
+ * comparing ages as numbers approximates LRU.  A single accessed bit
+ * only tells used from unused since the last scan.
+ *
+ * The eviction scan takes the page with the lowest aging_score():
+ * the age, above all of it whether the page was used since aged last
+ * looked, plus a penalty for pages that cost a write to evict.  A
+ * clean file page is dropped for free and read back later, while an
+ * anonymous page goes to swap, so the former goes first unless it is
+ * clearly hotter.  How much hotter is learned from refaults; see
+ * workingset.c.
+ *
+ * Like ksmd, aged only touches a process while it holds the process's
+ * spt lock and never waits for it; a busy process simply ages a
+ * period later. */
+
+#include "vm/aging.h"
+#include "vm/vm.h"
+#include "vm/workingset.h"
+#include "devices/timer.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <stdio.h>
+
+/* Top bit of an age: used during the last period. */
+#define AGE_RECENT 0x80
+
+/* Score of a page used since the last period, above any age. */
+#define SCORE_ACCESSED 0x100
+
+unsigned aging_interval_ms = 100;
+
+/* Protects spt_list. */
+static struct lock aging_lock;
+static struct list spt_list; // aged가 훑는 spt들
+
+/* Statistics. */
+static size_t passes;	   // 모든 프로세스를 한 바퀴 돈 횟수
+static size_t pages_aged;  // 나이를 갱신한 페이지 수
+static size_t busy_skips;  // spt 락이 잡혀 있어 건너뛴 횟수
+
+static void aged(void *aux);
+
+/* Initializes aging and, unless -age-ms=0 was given, starts aged. */
+void aging_init(void)
+{
+	lock_init(&aging_lock);
+	list_init(&spt_list);
+	if (aging_interval_ms > 0 && thread_create("aged", PRI_DEFAULT, aged, NULL) == TID_ERROR)
+	{
+		PANIC("aging_init: cannot start aged");
+	}
+}
+
+/* Lets aged scan SPT. */
+void aging_add(struct supplemental_page_table *spt)
+{
+	lock_acquire(&aging_lock);
+	list_push_back(&spt_list, &spt->age_elem);
+	lock_release(&aging_lock);
+}
+
+/* Stops aged from scanning SPT.  Once this returns, aged no longer
+ * refers to SPT. */
+void aging_remove(struct supplemental_page_table *spt)
+{
+	lock_acquire(&aging_lock);
+	list_remove(&spt->age_elem);
+	lock_release(&aging_lock);
+}
+
+/* Returns true if evicting PAGE means writing it out first. */
+static bool
+needs_writeback(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) == VM_ANON)
+	{
+		return true;
+	}
+	return !is_text_page(page) && pml4_is_dirty(page->owner->pml4, page->va);
+}
+
+/* Eviction score of PAGE, a resident page of the current process.
+ * The lower the score, the better PAGE is as a victim. */
+unsigned aging_score(struct page *page)
+{
+	unsigned score = page->age;
+	if (pml4_is_accessed(page->owner->pml4, page->va))
+	{
+		score |= SCORE_ACCESSED;
+	}
+	if (needs_writeback(page))
+	{
+		score += workingset_writeback_cost();
+	}
+	return score;
+}
+
+/* spt_apply() callback of aging_pass(): age PAGE by one period. */
+static bool
+age_page(struct page *page, void *aux UNUSED)
+{
+	if (page->frame == NULL)
+	{
+		return true;
+	}
+	uint64_t *pml4 = page->owner->pml4;
+	uint64_t *pte = pml4e_walk(pml4, (uint64_t)page->va, 0);
+	if (pte == NULL || !(*pte & PTE_P))
+	{
+		return true;
+	}
+	bool accessed = (*pte & PTE_A) != 0;
+	page->age = (page->age >> 1) | (accessed ? AGE_RECENT : 0);
+	pages_aged++;
+	// 큰 페이지는 512개 페이지가 비트 하나를 나눠 쓰므로 블록의 마지막 페이지에서 지운다.
+	void *next = page->va + PGSIZE;
+	if (accessed && (!(*pte & PTE_PS) || hpg_round_down(next) == next))
+	{
+		pml4_set_accessed(pml4, page->va, false);
+	}
+	return true;
+}
+
+/* Age every resident page of every process whose spt is not busy. */
+static void
+aging_pass(void)
+{
+	lock_acquire(&aging_lock);
+	for (struct list_elem *e = list_begin(&spt_list); e != list_end(&spt_list); e = list_next(e))
+	{
+		struct supplemental_page_table *spt = list_entry(e, struct supplemental_page_table, age_elem);
+		if (lock_try_acquire(&spt->lock))
+		{
+			spt_apply(spt, age_page, NULL);
+			lock_release(&spt->lock);
+		}
+		else
+		{
+			busy_skips++;
+		}
+	}
+	passes++;
+	lock_release(&aging_lock);
+}
+
+/* aged: age all pages every aging_interval_ms milliseconds. */
+static void
+aged(void *aux UNUSED)
+{
+	for (;;)
+	{
+		timer_msleep(aging_interval_ms);
+		aging_pass();
+	}
+}
+
+/* Prints aging statistics. */
+void aging_print_stats(void)
+{
+	printf("Aging: %zu passes, %zu pages aged, %zu busy processes skipped\n",
+		   passes, pages_aged, busy_skips);
+}
@@ -1,10 +1,12 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include "vm/ksm.h"
 #include "devices/disk.h"
 #include "threads/vaddr.h"
 #include <bitmap.h>
 #include "threads/mmu.h"
+#include "threads/synch.h"
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
 static bool anon_swap_in(struct page *page, void *kva);
@@ -19,7 +21,21 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* 한 페이지를 담는 데 필요한 섹터 수 */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Most pages written to (or read back from) swap with a single
+ * multi-sector transfer.  Neighbouring pages of the victim are
+ * evicted into consecutive slots so that a later fault on any of
+ * them can bring the whole run back in one disk round trip. */
+#define SWAP_CLUSTER 8
+
 struct bitmap *swap_table;
+static struct lock swap_lock;
+/* Next-fit cursor: slot scans start where the last cluster ended
+ * instead of at slot 0, so consecutive evictions land next to each
+ * other on disk. */
+static size_t swap_cursor;
 
 /* Initialize the data for anonymous pages */
 void vm_anon_init(void)
@@ -27,8 +43,10 @@ void vm_anon_init(void)
 	/* TODO: Set up the swap_disk. */
 	swap_disk = disk_get(1, 1); // swap 디스크를 가져옴
 	// swap 디스크에서 최대 할당할 수 있는 페이지 수
-	size_t swap_size = disk_size(swap_disk) / 8;
+	size_t swap_size = disk_size(swap_disk) / SECTORS_PER_PAGE;
 	swap_table = bitmap_create(swap_size);
+	lock_init(&swap_lock);
+	swap_cursor = 0;
 }
 /* Initialize the file mapping */
 bool anon_initializer(struct page *page, enum vm_type type, void *kva)
@@ -40,64 +58,335 @@ bool anon_initializer(struct page *page, enum vm_type type, void *kva)
 	struct anon_page *anon_page = &page->anon;
 
 	anon_page->swap_slot = -1;
+	anon_page->ksm = NULL;
+	anon_page->ksm_sum = 0;
 
 	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Reserve CNT contiguous swap slots and return the first one, or
+ * BITMAP_ERROR if no run that long is free.  Scanning starts at the
+ * next-fit cursor and wraps around once. */
+static size_t
+swap_alloc(size_t cnt)
+{
+	lock_acquire(&swap_lock);
+	size_t slot = bitmap_scan_and_flip(swap_table, swap_cursor, cnt, false);
+	if (slot == BITMAP_ERROR && swap_cursor != 0)
+	{
+		slot = bitmap_scan_and_flip(swap_table, 0, cnt, false);
+	}
+	if (slot != BITMAP_ERROR)
+	{
+		swap_cursor = slot + cnt;
+		if (swap_cursor >= bitmap_size(swap_table))
+		{
+			swap_cursor = 0;
+		}
+	}
+	lock_release(&swap_lock);
+	return slot;
+}
+
+/* Release CNT swap slots starting at SLOT. */
+static void
+swap_free(size_t slot, size_t cnt)
+{
+	lock_acquire(&swap_lock);
+	ASSERT(bitmap_all(swap_table, slot, cnt));
+	bitmap_set_multiple(swap_table, slot, cnt, false);
+	lock_release(&swap_lock);
+}
+
+/* Returns the page of the current process at VA if it is a
+ * resident anonymous page that may be swapped out together with
+ * a victim, that is, one that has not been touched recently. */
+static struct page *
+cluster_candidate(void *va)
+{
+	struct thread *cur = thread_current();
+	if (is_kernel_vaddr(va) || va < (void *)PGSIZE)
+	{
+		return NULL;
+	}
+	struct page *page = spt_find_page(&cur->spt, va);
+	// 병합된 페이지는 다른 프로세스와 프레임을 같이 쓰므로 따로 내보낸다.
+	if (page == NULL || page->operations != &anon_ops || page->frame == NULL ||
+		page->anon.ksm != NULL || is_pinned_page(page))
+	{
+		return NULL;
+	}
+	if (pml4_is_accessed(cur->pml4, page->va))
+	{
+		return NULL;
+	}
+	return page;
+}
+
+/* Write the page at KVA to a swap slot of its own.  Returns the
+ * slot, or -1 if swap is full.  Used for pages that cannot be
+ * clustered, such as merged pages evicted by ksm_evict(). */
+int anon_swap_write(void *kva)
+{
+	size_t slot = swap_alloc(1);
+	if (slot == BITMAP_ERROR)
+	{
+		return -1;
+	}
+	disk_write_multiple(swap_disk, slot * SECTORS_PER_PAGE, &kva, 1, SECTORS_PER_PAGE);
+	return slot;
+}
+
+/* Read the page that anon_swap_write() put in SLOT into KVA.  The
+ * slot stays allocated until anon_swap_drop(). */
+void anon_swap_read(int slot, void *kva)
+{
+	ASSERT(slot >= 0 && bitmap_test(swap_table, slot));
+	disk_read_multiple(swap_disk, slot * SECTORS_PER_PAGE, &kva, 1, SECTORS_PER_PAGE);
+}
+
+/* Release SLOT, written by anon_swap_write(). */
+void anon_swap_drop(int slot)
+{
+	swap_free(slot, 1);
+}
+
+/* Returns the page of OWNER at VA if it was swapped out into SLOT,
+ * so that it can be read back along with its neighbour. */
+static struct page *
+readahead_candidate(struct thread *owner, void *va, long slot)
+{
+	if (is_kernel_vaddr(va) || va < (void *)PGSIZE || slot < 0 ||
+		(size_t)slot >= bitmap_size(swap_table))
+	{
+		return NULL;
+	}
+	struct page *page = spt_find_page(&owner->spt, va);
+	if (page == NULL || page->operations != &anon_ops || page->frame != NULL ||
+		page->anon.swap_slot != slot)
+	{
+		return NULL;
+	}
+	return page;
+}
+
+/* Swap in the page by read contents from the swap disk.
+ * Neighbouring pages that were evicted in the same cluster, i.e.
+ * adjacent virtual pages sitting in adjacent slots, are read with
+ * the same transfer as long as free frames are available.  PAGE
+ * need not belong to the current thread (see madvise.c). */
 static bool
 anon_swap_in(struct page *page, void *kva)
 {
 	struct anon_page *anon_page = &page->anon;
+	struct thread *cur = page->owner;
 	// 익명 페이지 안에 swapout될 때 저장된 swap_slot 정보를 가져옴
 	int swap_slot = anon_page->swap_slot;
-	// printf("%d\n", swap_slot);
+	// 내용을 버린 페이지(MADV_DONTNEED)는 0으로 채워진 프레임을 그대로 쓴다.
+	if (swap_slot < 0)
+	{
+		return true;
+	}
 	// 그 정보를 기반으로 해당 swap_slot이 사용중인지 체크
 	if (!bitmap_test(swap_table, swap_slot))
 	{
 		return false;
 	}
-	// 해당 swap_slot 에 있는 데이터를 kva에 다시 써준다.
-	for (int i = 0; i < 8; i++)
+
+	// 같은 클러스터로 내보내진 이웃 페이지들을 앞뒤로 모은다.
+	struct page *run[SWAP_CLUSTER];
+	void *bufs[SWAP_CLUSTER];
+	int lo = 0, hi = 0;
+	while (hi - lo + 1 < SWAP_CLUSTER &&
+		   readahead_candidate(cur, page->va + (hi + 1) * PGSIZE, swap_slot + hi + 1))
+	{
+		hi++;
+	}
+	while (hi - lo + 1 < SWAP_CLUSTER &&
+		   readahead_candidate(cur, page->va + (lo - 1) * PGSIZE, swap_slot + lo - 1))
+	{
+		lo--;
+	}
+
+	// 이웃 페이지에는 남는 프레임이 있을 때만 미리 읽기를 해준다.
+	int cnt = 0, first = 0;
+	for (int i = lo; i <= hi; i++)
+	{
+		struct page *p = i == 0 ? page : spt_find_page(&cur->spt, page->va + i * PGSIZE);
+		void *buf = i == 0 ? kva : NULL;
+		if (i != 0)
+		{
+			struct frame *frame = vm_try_get_frame();
+			if (frame == NULL)
+			{
+				if (i < 0)
+				{
+					// 앞쪽에서 프레임이 모자라면 그 앞은 모두 버리고 다시 시작
+					for (int j = 0; j < cnt; j++)
+					{
+						vm_free_frame(run[j]->frame);
+						vm_page_clear_frame(run[j]);
+					}
+					cnt = 0;
+					continue;
+				}
+				break;
+			}
+			frame->page = p;
+			frame->owner = cur;
+			vm_page_set_frame(p, frame);
+			buf = frame->kva;
+		}
+		if (cnt == 0)
+		{
+			first = i;
+		}
+		run[cnt] = p;
+		bufs[cnt] = buf;
+		cnt++;
+	}
+
+	// 해당 swap_slot 에 있는 데이터를 한 번의 전송으로 다시 읽어온다.
+	disk_read_multiple(swap_disk, (swap_slot + first) * SECTORS_PER_PAGE,
+					   bufs, cnt, SECTORS_PER_PAGE);
+
+	for (int i = 0; i < cnt; i++)
 	{
-		disk_read(swap_disk, swap_slot * 8 + i, kva + i * DISK_SECTOR_SIZE);
+		struct page *p = run[i];
+		if (p != page &&
+			!pml4_set_page(cur->pml4, p->va, p->frame->kva, p->writable))
+		{
+			// 매핑에 실패한 이웃은 다시 swap된 상태로 남겨둔다.
+			vm_free_frame(p->frame);
+			vm_page_clear_frame(p);
+			continue;
+		}
+		// swap 디스크에서 다시 데이터를 메모리로 가져왔으므로 디스크가 비어있다고 알려줌
+		swap_free(p->anon.swap_slot, 1);
+		p->anon.swap_slot = -1;
+		vm_account(&p->owner->swap_cnt, -1);
 	}
-	// swap 디스크에서 다시 데이터를 메모리로 가져왔으므로 디스크가 비어있다고 알려줌
-	bitmap_set(swap_table, swap_slot, false);
-	// anon_page->swap_slot = -1;
 	return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Swap out the page by writing contents to the swap disk.
+ * Resident, not recently accessed anonymous neighbours of PAGE are
+ * evicted along with it into a contiguous run of slots with one
+ * multi-sector write; their frames are released here, while PAGE's
+ * frame is handed back to the caller for reuse. */
 static bool
 anon_swap_out(struct page *page)
 {
-	struct anon_page *anon_page = &page->anon;
-	// 1. 비어 있는 swap 슬롯을 찾는다.
-	int empty_swap_slot = bitmap_scan(swap_table, 0, 1, false);
-	if (empty_swap_slot == BITMAP_ERROR)
+	struct thread *cur = thread_current();
+	struct page *run[SWAP_CLUSTER];
+	void *bufs[SWAP_CLUSTER];
+	int lo = 0, hi = 0;
+
+	// 1. 희생 페이지 주변에서 함께 내보낼 이웃 페이지들을 고른다.
+	while (hi - lo + 1 < SWAP_CLUSTER &&
+		   cluster_candidate(page->va + (hi + 1) * PGSIZE))
 	{
-		// 비어있는 슬롯 없을 경우 false 때림
-		return false;
+		hi++;
+	}
+	while (hi - lo + 1 < SWAP_CLUSTER &&
+		   cluster_candidate(page->va + (lo - 1) * PGSIZE))
+	{
+		lo--;
 	}
-	// 2. 페이지 내용을 swap 디스크에 기록한다.
-	for (int i = 0; i < 8; i++)
+
+	// 2. 연속된 swap 슬롯을 확보한다. 자리가 없으면 클러스터를 줄여본다.
+	size_t slot;
+	while ((slot = swap_alloc(hi - lo + 1)) == BITMAP_ERROR)
 	{
-		disk_write(swap_disk, empty_swap_slot * 8 + i, page->frame->kva + i * DISK_SECTOR_SIZE);
+		if (hi == 0 && lo == 0)
+		{
+			// 비어있는 슬롯 없을 경우 false 때림
+			return false;
+		}
+		if (hi > -lo)
+			hi--;
+		else
+			lo++;
+	}
+
+	int cnt = 0;
+	for (int i = lo; i <= hi; i++)
+	{
+		struct page *p = i == 0 ? page : spt_find_page(&cur->spt, page->va + i * PGSIZE);
+		run[cnt] = p;
+		bufs[cnt] = p->frame->kva;
+		cnt++;
+	}
+
+	// 3. 페이지 내용들을 한 번의 전송으로 swap 디스크에 기록한다.
+	disk_write_multiple(swap_disk, slot * SECTORS_PER_PAGE, bufs, cnt,
+						SECTORS_PER_PAGE);
+
+	// 4. 익명 페이지에 swap 슬롯 정보를 기록하고 매핑을 끊는다.
+	for (int i = 0; i < cnt; i++)
+	{
+		struct page *p = run[i];
+		p->anon.swap_slot = slot + i;
+		vm_account(&p->owner->swap_cnt, 1);
+		pml4_set_accessed(cur->pml4, p->va, false);
+		pml4_clear_page(cur->pml4, p->va); // 스왑영역으로 들어갔으니 페이지테이블 클리어
+		if (p != page)
+		{
+			vm_free_frame(p->frame);
+		}
+		vm_page_clear_frame(p); // 프레임도 해제
 	}
-	// 3. 익명 페이지에 swap 슬롯 정보를 기록
-	anon_page->swap_slot = empty_swap_slot;
-	// 4. 페이지 상태를 업데이트
-	bitmap_set(swap_table, empty_swap_slot, true); // 스왑영역 사용중으로 표시
-	pml4_set_accessed(thread_current()->pml4, page->va, false);
-	pml4_clear_page(thread_current()->pml4, page->va); // 스왑영역으로 들어갔으니 페이지테이블 클리어
-	page->frame = NULL;								   // 프레임도 해제
 	return true;
 }
 
+/* Drop the contents of PAGE, a page of the current thread: free its
+ * frame or swap slot, so that it reads as zeros when next touched. */
+void anon_discard(struct page *page)
+{
+	struct anon_page *anon_page = &page->anon;
+	if (anon_page->ksm != NULL)
+	{
+		// 병합된 페이지는 늘 올라와 있다.
+		vm_account(&page->owner->rss, -1);
+		ksm_destroy(page);
+	}
+	else if (page->frame != NULL)
+	{
+		vm_unmap_page(page);
+		vm_free_frame(page->frame);
+		vm_page_clear_frame(page);
+	}
+	else if (anon_page->swap_slot >= 0)
+	{
+		swap_free(anon_page->swap_slot, 1);
+		vm_account(&page->owner->swap_cnt, -1);
+	}
+	anon_page->swap_slot = -1;
+}
+
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy(struct page *page)
 {
 	struct anon_page *anon_page = &page->anon;
+	// 병합된 페이지는 공유 프레임에서 떼어 낸다.
+	if (anon_page->ksm != NULL)
+	{
+		ksm_destroy(page);
+		return;
+	}
+	// 올라와 있는 페이지는 매핑을 풀고 프레임을 돌려준다. 일괄 해제 중이면 TLB를 비운 뒤에 풀린다.
+	if (page->frame != NULL)
+	{
+		vm_unmap_page(page);
+		vm_free_frame(page->frame);
+		page->frame = NULL;
+	}
+	// 디스크에 내려가 있던 페이지라면 슬롯을 반납한다.
+	else if (anon_page->swap_slot >= 0)
+	{
+		swap_free(anon_page->swap_slot, 1);
+		anon_page->swap_slot = -1;
+		vm_account(&page->owner->swap_cnt, -1);
+	}
 }
@@ -0,0 +1,96 @@
+/* faultstat.c: Page fault latency statistics.
+ *
+ * Every resolved page fault is timed with the time-stamp counter,
+ * from the moment vm_try_handle_fault() is entered until the page is
+ * mapped, and filed under the kind of work it took: a minor fault
+ * (zero fill or a page already in memory), a major fault (a read from
+ * a file or from swap), a stack growth or a copy-on-write break.
+ * Evictions are timed the same way, separately; their time is also
+ * part of the fault that needed the frame.
+ *
+ * Each process keeps a count and a cycle total per kind (struct
+ * thread), which faultstat() reports alongside the system-wide
+ * latency histograms kept here.  The histograms are printed at
+ * shutdown.  Counters are updated with interrupts off and read
+ * without, so a reader may see an event half-counted. */
+
+#include "vm/faultstat.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *kind_names[FAULT_KIND_CNT] = {"minor", "major", "stack", "cow", "evict"};
+
+/* System-wide, over all processes. */
+static size_t counts[FAULT_KIND_CNT];
+static uint64_t cycles[FAULT_KIND_CNT];
+static size_t hist[FAULT_KIND_CNT][FAULT_HIST_CNT];
+
+/* Returns the time stamp to pass to faultstat_record() once the
+ * event has been dealt with. */
+uint64_t faultstat_start(void)
+{
+	return rdtsc();
+}
+
+/* Returns the histogram bucket of an event that took CYCLES. */
+static int
+hist_bucket(uint64_t cycles)
+{
+	int bucket = 0;
+	for (cycles >>= FAULT_HIST_SHIFT + 1; cycles != 0 && bucket < FAULT_HIST_CNT - 1; cycles >>= 1)
+	{
+		bucket++;
+	}
+	return bucket;
+}
+
+/* Records an event of KIND, one of the FAULT_* kinds, that began at
+ * START, for the current process and system-wide. */
+void faultstat_record(int kind, uint64_t start)
+{
+	ASSERT(kind >= 0 && kind < FAULT_KIND_CNT);
+	uint64_t elapsed = rdtsc() - start;
+	struct thread *cur = thread_current();
+
+	enum intr_level old_level = intr_disable();
+	cur->fault_kind_cnt[kind]++;
+	cur->fault_cycles[kind] += elapsed;
+	counts[kind]++;
+	cycles[kind] += elapsed;
+	hist[kind][hist_bucket(elapsed)]++;
+	intr_set_level(old_level);
+}
+
+/* Copies the system-wide histograms into ST. */
+void faultstat_fill_hist(struct faultstat *st)
+{
+	memcpy(st->hist, hist, sizeof hist);
+}
+
+/* Prints the event counts, average latencies and the non-empty
+ * buckets of each histogram, labelled with their lower bound as a
+ * power of two. */
+void faultstat_print_stats(void)
+{
+	for (int kind = 0; kind < FAULT_KIND_CNT; kind++)
+	{
+		if (counts[kind] == 0)
+		{
+			continue;
+		}
+		printf("Faults: %zu %s, %llu cycles on average, by 2^n cycles:",
+			   counts[kind], kind_names[kind],
+			   (unsigned long long)(cycles[kind] / counts[kind]));
+		for (int i = 0; i < FAULT_HIST_CNT; i++)
+		{
+			if (hist[kind][i] != 0)
+			{
+				printf(" %d:%zu", i + FAULT_HIST_SHIFT, hist[kind][i]);
+			}
+		}
+		printf("\n");
+	}
+}
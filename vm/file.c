@@ -4,11 +4,19 @@
 #include "userprog/process.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/mmu.h"
+#include "threads/synch.h"
+#include "filesys/inode.h"
+#include "devices/disk.h"
+#include "vm/writeback.h"
 #include <string.h>
 static bool file_backed_swap_in(struct page *page, void *kva);
 static bool file_backed_swap_out(struct page *page);
 static void file_backed_destroy(struct page *page);
+static bool text_swap_in(struct page *page, void *kva);
+static bool text_swap_out(struct page *page);
+static void text_destroy(struct page *page);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -18,19 +26,79 @@ static const struct page_operations file_ops = {
 	.type = VM_FILE,
 };
 
+/* Read-only executable text.  The frame belongs to a text_entry and
+ * is mapped into every process running the same file. */
+static const struct page_operations text_ops = {
+	.swap_in = text_swap_in,
+	.swap_out = text_swap_out,
+	.destroy = text_destroy,
+	.type = VM_FILE | VM_TEXT,
+};
+
+/* One page of an executable, shared by every text page that maps
+ * the same bytes of the same inode.  The entry lives as long as
+ * some text page refers to it; its frame is dropped on eviction and
+ * whenever nobody has it mapped. */
+struct text_entry
+{
+	struct hash_elem elem;
+	struct inode *inode;
+	off_t offset;
+	size_t read_bytes;
+	struct file *file;		 // 캐시 전용으로 다시 연 파일
+	struct frame *frame;	 // 올라와 있는 공유 프레임, 없으면 NULL
+	bool loading;			 // 어떤 프로세스가 프레임을 읽어 오는 중이다
+	struct condition loaded; // 읽기가 끝나길 기다리는 폴트들
+	int ref_cnt;			 // 이 항목을 가리키는 페이지 수 (모든 프로세스 합산)
+	struct list sharers;	 // 지금 프레임을 매핑하고 있는 페이지들
+};
+
+static struct hash text_cache;
+static struct lock text_lock;
+
+static uint64_t
+text_hash_func(const struct hash_elem *e, void *aux UNUSED)
+{
+	struct text_entry *t = hash_entry(e, struct text_entry, elem);
+	uint64_t key[3] = {(uint64_t)t->inode, t->offset, t->read_bytes};
+	return hash_bytes(key, sizeof key);
+}
+
+static bool
+text_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	struct text_entry *x = hash_entry(a, struct text_entry, elem);
+	struct text_entry *y = hash_entry(b, struct text_entry, elem);
+	if (x->inode != y->inode)
+	{
+		return x->inode < y->inode;
+	}
+	if (x->offset != y->offset)
+	{
+		return x->offset < y->offset;
+	}
+	return x->read_bytes < y->read_bytes;
+}
+
 /* The initializer of file vm */
 void vm_file_init(void)
 {
+	hash_init(&text_cache, text_hash_func, text_less_func, NULL);
+	lock_init(&text_lock);
 }
 
 /* Initialize the file backed page */
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva)
 {
+	// uninit과 file_page가 같은 공간을 쓰므로 aux를 먼저 꺼내 둔다.
+	struct load_info *aux = page->uninit.aux;
+
 	/* Set up the handler */
-	page->operations = &file_ops;
+	page->operations = type & VM_TEXT ? &text_ops : &file_ops;
 
 	struct file_page *file_page = &page->file;
-	file_page->fr = page->uninit.aux;
+	file_page->fr = aux;
+	file_page->text = NULL;
 	return true;
 }
 
@@ -39,12 +107,18 @@ static bool
 file_backed_swap_in(struct page *page, void *kva)
 {
 	struct file_page *file_page = &page->file;
-	file_seek(file_page->fr->file, file_page->fr->offset);
-	if (file_read(file_page->fr->file, kva, file_page->fr->read_bytes) != file_page->fr->read_bytes)
+	struct load_info *fr = file_page->fr;
+	// 깨끗해서 그냥 버린 페이지를 다시 읽는다. 파일 위치는 다른 스레드와 공유하니 건드리지 않는다.
+	if (fr->read_bytes == PGSIZE && fr->offset % DISK_SECTOR_SIZE == 0)
+	{
+		void *pages[1] = {kva};
+		return file_read_pages(fr->file, pages, 1, fr->offset) == PGSIZE;
+	}
+	if (file_read_at(fr->file, kva, fr->read_bytes, fr->offset) != (off_t)fr->read_bytes)
 	{
 		return false;
 	}
-	memset(kva + file_page->fr->read_bytes, 0, file_page->fr->zero_bytes);
+	memset(kva + fr->read_bytes, 0, fr->zero_bytes);
 	return true;
 }
 
@@ -55,15 +129,15 @@ file_backed_swap_out(struct page *page)
 	// 파일 시스템의 파일에 데이터가 저장되어 있기 때문에
 	// 그 파일을 다시 사용할 수 있도록 메모리에서만 제거
 	struct file_page *file_page = &page->file;
-	// 1. 페이지가 dirty(수정됨)인 경우 파일에 다시 기록한다.
+	// 1. 페이지가 dirty(수정됨)인 경우 파일에 다시 기록한다. 섹터별로 나누지 않고 한 번에 쓴다.
 	if (pml4_is_dirty(thread_current()->pml4, page->va))
 	{
-		file_seek(file_page->fr->file, file_page->fr->offset);
-		file_write(file_page->fr->file, page->frame->kva, file_page->fr->read_bytes);
+		file_write_pages(file_page->fr->file, &page->frame->kva, 1, file_page->fr->offset,
+						 file_page->fr->read_bytes);
 	}
 	// 2. 페이지 테이블에서 페이지를 제거하고, 프레임 해제
 	pml4_clear_page(thread_current()->pml4, page->va);
-	page->frame = NULL;
+	vm_page_clear_frame(page);
 	return true;
 }
 
@@ -71,7 +145,30 @@ file_backed_swap_out(struct page *page)
 static void
 file_backed_destroy(struct page *page)
 {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct load_info *fr = file_page->fr;
+	if (page->frame != NULL)
+	{
+		// 수정된 내용은 파일에 다시 쓰고 프레임을 돌려준다.
+		bool dirty = pml4_is_dirty(page->owner->pml4, page->va);
+		struct writeback *wb = page->owner->spt.wb;
+		vm_unmap_page(page);
+		if (dirty && wb != NULL)
+		{
+			// munmap이나 종료 중이면 배치가 오프셋 순으로 모아 쓰고 프레임도 해제한다.
+			writeback_add(wb, fr->file, fr->offset, fr->read_bytes, page->frame);
+		}
+		else
+		{
+			if (dirty)
+			{
+				file_write_pages(fr->file, &page->frame->kva, 1, fr->offset, fr->read_bytes);
+			}
+			vm_free_frame(page->frame);
+		}
+		page->frame = NULL;
+	}
+	kmem_cache_free(load_info_cache, fr);
 }
 
 static bool
@@ -92,7 +189,7 @@ lazy_load(struct page *page, void *aux)
 	}
 	// 페이지의 나머지 부분을 0으로 채움.
 	memset(kpage + load_info->read_bytes, 0, load_info->zero_bytes);
-	pml4_set_dirty(thread_current()->pml4, page->va, false);
+	pml4_set_dirty(page->owner->pml4, page->va, false);
 	// printf("do_mmapfdhgdfh\n");
 	return true;
 }
@@ -103,75 +200,234 @@ do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset)
 {
 	// ASSERT(offset % PGSIZE == 0);
-	void *start_addr = addr;
-	// 파일에 대한 독립적인 참조 얻기
-	struct file *reopened_file = file_reopen(file);
-	off_t file_len = file_length(reopened_file);
-	// 페이지 생성 개수
-	int cnt = (int)pg_round_up(length) / PGSIZE;
-	long len = length;
-	for (int i = 0; i < cnt; i++)
-	{
-
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = file_len < PGSIZE ? file_len : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-		// printf("length: %d\n", page_read_bytes);
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct load_info *aux = malloc(sizeof(struct load_info));
-		if (aux == NULL)
+	off_t file_len = file_length(file);
+	if (file_len <= 0)
+	{
+		return NULL;
+	}
+	// 파일 끝을 넘는 부분은 0으로 채운다.
+	size_t file_bytes = offset < file_len ? file_len - offset : 0;
+	if (file_bytes > length)
+	{
+		file_bytes = length;
+	}
+	// 페이지는 처음 접근할 때 구역 정보로부터 만들어진다.
+	struct vm_region *region = region_create(&thread_current()->spt, addr, length, VM_FILE,
+											 writable, file, offset, file_bytes, lazy_load);
+	if (region == NULL)
+	{
+		return NULL;
+	}
+	region->mmap = true;
+	return addr;
+}
+
+/* Do the munmap */
+void do_munmap(void *addr)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct vm_region *region = region_find(spt, addr);
+	if (region == NULL || !region->mmap || region->start != addr)
+	{
+		return;
+	}
+	// 수정된 페이지는 페이지를 지울 때 파일에 다시 쓴다.
+	lock_acquire(&spt->lock);
+	region_destroy(spt, region);
+	lock_release(&spt->lock);
+}
+
+/* Turn the uninit text page PAGE into a text page and attach it to
+ * the cache entry for its bytes of the executable, creating the
+ * entry if this is the first process to touch them. */
+static bool
+text_attach(struct page *page)
+{
+	struct load_info *info = page->uninit.aux;
+	struct text_entry key;
+	struct text_entry *e;
+
+	key.inode = file_get_inode(info->file);
+	key.offset = info->offset;
+	key.read_bytes = info->read_bytes;
+
+	lock_acquire(&text_lock);
+	struct hash_elem *found = hash_find(&text_cache, &key.elem);
+	if (found != NULL)
+	{
+		e = hash_entry(found, struct text_entry, elem);
+	}
+	else
+	{
+		e = malloc(sizeof *e);
+		struct file *file = e != NULL ? file_reopen(info->file) : NULL;
+		if (file == NULL)
 		{
-			file_close(reopened_file);
-			return NULL;
+			free(e);
+			lock_release(&text_lock);
+			return false;
 		}
-		aux->file = reopened_file;
-		aux->offset = offset;
-		aux->read_bytes = page_read_bytes;
-		aux->zero_bytes = page_zero_bytes;
-		aux->cnt = cnt;
-		// munmap용 파일 데이터 저장
-		if (!vm_alloc_page_with_initializer(VM_FILE, addr,
-											writable, lazy_load, aux))
+		e->inode = key.inode;
+		e->offset = key.offset;
+		e->read_bytes = key.read_bytes;
+		e->file = file;
+		e->frame = NULL;
+		e->loading = false;
+		cond_init(&e->loaded);
+		e->ref_cnt = 0;
+		list_init(&e->sharers);
+		hash_insert(&text_cache, &e->elem);
+	}
+	e->ref_cnt++;
+	lock_release(&text_lock);
+
+	file_backed_initializer(page, VM_FILE | VM_TEXT, NULL);
+	page->file.text = e;
+	return true;
+}
+
+/* Claim the text page PAGE: map the shared frame of its cache entry
+ * read-only, loading it from the executable first if no process has
+ * it in memory.  Only one process reads a given page; the others
+ * that fault on it meanwhile sleep until the read is done. */
+bool file_text_claim(struct page *page)
+{
+	if (page->operations != &text_ops && !text_attach(page))
+	{
+		return false;
+	}
+	struct text_entry *e = page->file.text;
+
+	lock_acquire(&text_lock);
+	// 다른 프로세스가 이미 읽고 있으면 같은 페이지를 또 읽지 않고 그 읽기를 기다린다.
+	while (e->loading)
+	{
+		cond_wait(&e->loaded, &text_lock);
+	}
+	if (e->frame == NULL)
+	{
+		// 디스크 읽기와 축출은 오래 걸리므로 락을 놓고 프레임을 채운다.
+		e->loading = true;
+		lock_release(&text_lock);
+		struct frame *frame = vm_get_frame();
+		bool success = frame != NULL;
+		if (success)
+		{
+			frame->page = page;
+			bool released = vm_io_begin();
+			success = text_swap_in(page, frame->kva);
+			vm_io_end(released);
+		}
+		lock_acquire(&text_lock);
+		e->loading = false;
+		cond_broadcast(&e->loaded, &text_lock);
+		if (!success)
 		{
-			free(aux);
-			file_close(reopened_file);
-			return NULL;
+			lock_release(&text_lock);
+			if (frame != NULL)
+			{
+				vm_free_frame(frame);
+			}
+			return false;
 		}
-		/* Advance. */
-		file_len -= page_read_bytes;
-		len -= page_read_bytes;
-		offset += page_read_bytes;
-		addr += PGSIZE;
+		e->frame = frame;
+	}
+	if (!pml4_set_page(page->owner->pml4, page->va, e->frame->kva, false))
+	{
+		lock_release(&text_lock);
+		return false;
 	}
-	return start_addr;
+	vm_page_set_frame(page, e->frame);
+	list_push_back(&e->sharers, &page->file.text_elem);
+	lock_release(&text_lock);
+	return true;
 }
 
-/* Do the munmap */
-void do_munmap(void *addr)
+/* Read the contents of the text page PAGE from the executable. */
+static bool
+text_swap_in(struct page *page, void *kva)
 {
-	// printf("HI\n\n");
-	struct page *find_page = spt_find_page(&thread_current()->spt, addr);
-	struct load_info *find_aux = find_page->file.fr;
-	struct file *find_file = find_aux->file;
-	if (VM_TYPE(find_page->operations->type) != VM_FILE || find_aux->cnt == 0)
+	struct text_entry *e = page->file.text;
+	if (file_read_at(e->file, kva, e->read_bytes, e->offset) != (int)e->read_bytes)
 	{
-		return;
+		return false;
 	}
-	int find_cnt = find_aux->cnt;
-	// printf("cnt:%d\n", find_cnt);
-	while (find_cnt > 0)
+	memset(kva + e->read_bytes, 0, PGSIZE - e->read_bytes);
+	return true;
+}
+
+/* Evict the shared frame of PAGE's entry.  Text is never dirty, so
+ * it is enough to unmap it from every process that shares it; the
+ * next fault in any of them reads it back from the executable.
+ * Returns the frame, or NULL if it is pinned, or if another sharer
+ * evicted it since PAGE's frame was looked at. */
+struct frame *
+text_evict(struct page *page)
+{
+	struct text_entry *e = page->file.text;
+
+	lock_acquire(&text_lock);
+	struct frame *frame = e->frame;
+	// 다른 공유자가 먼저 내보냈거나 그 뒤 다시 읽어 온 프레임이면 손대지 않는다.
+	if (frame == NULL || frame != page->frame || frame->pin_cnt > 0)
+	{
+		lock_release(&text_lock);
+		return NULL;
+	}
+	while (!list_empty(&e->sharers))
+	{
+		struct page *p = list_entry(list_pop_front(&e->sharers), struct page, file.text_elem);
+		pml4_clear_page(p->owner->pml4, p->va);
+		vm_page_clear_frame(p);
+	}
+	e->frame = NULL;
+	lock_release(&text_lock);
+	return frame;
+}
+
+static bool
+text_swap_out(struct page *page)
+{
+	return text_evict(page) != NULL;
+}
+
+/* Detach the text page PAGE from its entry.  The mapping is cleared
+ * here so that pml4_destroy() does not free a frame other processes
+ * still use; the frame goes away with the last process mapping it,
+ * and the entry with the last page referring to it. */
+static void
+text_destroy(struct page *page)
+{
+	struct text_entry *e = page->file.text;
+
+	lock_acquire(&text_lock);
+	if (page->frame != NULL)
 	{
-		struct page *find_page = spt_find_page(&thread_current()->spt, addr);
-		// spt_remove_page(&thread_current()->spt, find_page);
-		if (pml4_is_dirty(thread_current()->pml4, find_page->va))
+		// mlock()이 걸어 둔 공유 프레임 고정을 푼다.
+		if (page->locked)
 		{
-			file_seek(find_aux->file, find_aux->offset);
-			file_write(find_aux->file, find_page->frame->kva, find_aux->read_bytes);
+			page->frame->pin_cnt--;
 		}
-		addr += PGSIZE;
-		find_cnt--;
+		list_remove(&page->file.text_elem);
+		vm_unmap_page(page);
+		page->frame = NULL;
+		if (list_empty(&e->sharers))
+		{
+			vm_free_frame(e->frame);
+			e->frame = NULL;
+		}
+		else if (e->frame->page == page)
+		{
+			// 축출 때 쓸 대표 페이지를 살아 있는 다른 공유자로 바꾼다.
+			e->frame->page = list_entry(list_front(&e->sharers), struct page, file.text_elem);
+		}
+	}
+	if (--e->ref_cnt == 0)
+	{
+		hash_delete(&text_cache, &e->elem);
+		file_close(e->file);
+		free(e);
 	}
-	file_close(find_file);
+	lock_release(&text_lock);
+	kmem_cache_free(load_info_cache, page->file.fr);
 }
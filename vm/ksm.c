@@ -0,0 +1,557 @@
+/* ksm.c: Same-page merging for anonymous memory.
+ *
+ * A kernel thread, ksmd, walks the resident anonymous pages of every
+ * process a few at a time and merges pages with identical contents
+ * into one read-only frame.  A write to a merged page faults, and the
+ * writer gets its own copy back (ksm_break()).
+ *
+ * Merged frames are kept in the stable table, keyed by a checksum of
+ * their contents.  A page that matches no merged frame is remembered
+ * in the unstable table until the end of the pass, and a later page
+ * with the same checksum is merged with it into a new stable frame.
+ * Only pages whose checksum has not changed since the previous pass
+ * go into the unstable table, so pages that are written all the time
+ * are left alone.  The checksum only picks candidates: both pages are
+ * write-protected and compared byte by byte before they are merged.
+ *
+ * ksmd only touches a process while it holds the process's spt lock,
+ * which the fault handler and everything else that changes the spt
+ * also hold.  It never waits for that lock; a busy process is simply
+ * skipped until the next pass. */
+
+#include "vm/ksm.h"
+#include "vm/vm.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <stdio.h>
+#include <string.h>
+
+/* A frame shared read-only by every page whose contents equal it. */
+struct ksm_entry
+{
+	struct hash_elem elem;
+	uint32_t sum;		 // 프레임 내용의 체크섬
+	struct frame *frame; // 공유하는 읽기 전용 프레임
+	struct list sharers; // 이 프레임을 매핑한 페이지들 (모든 프로세스 합산)
+};
+
+/* A page seen during the current pass that has not found a twin yet.
+ * The page itself may be gone by the time the twin turns up, so it is
+ * looked up again through its spt. */
+struct ksm_item
+{
+	struct hash_elem elem;
+	uint32_t sum;
+	struct supplemental_page_table *spt;
+	void *va;
+};
+
+/* One call of ksm_scan() over one spt. */
+struct ksm_batch
+{
+	struct supplemental_page_table *spt;
+	void *start;   // 이 주소부터 훑는다
+	size_t budget; // 남은 페이지 수
+	void *next;	   // 다 못 훑었으면 다음에 시작할 주소
+};
+
+size_t ksm_pages_to_scan;
+unsigned ksm_sleep_ms = 20;
+
+/* Protects everything below, the sharers of every entry and the
+ * ksm fields of merged pages. */
+static struct lock ksm_lock;
+static struct hash stable;
+static struct hash unstable;
+static struct kmem_cache *item_cache;
+static struct list spt_list;					// ksmd가 훑는 spt들
+static struct supplemental_page_table *cursor; // 지금 훑고 있는 spt, 패스 처음이면 NULL
+static void *cursor_va;
+
+/* Statistics. */
+static size_t pages_merged;	 // 공유 프레임을 매핑한 페이지 수
+static size_t merges;		 // 병합한 횟수
+static size_t unmerges;		 // 쓰기, 축출, 해제로 병합이 풀린 페이지 수
+static size_t pages_scanned; // 훑은 익명 페이지 수
+static size_t full_scans;	 // 모든 프로세스를 한 바퀴 돈 횟수
+
+static void ksmd(void *aux);
+
+static uint64_t
+entry_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	return hash_int(hash_entry(e, struct ksm_entry, elem)->sum);
+}
+
+static bool
+entry_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	return hash_entry(a, struct ksm_entry, elem)->sum < hash_entry(b, struct ksm_entry, elem)->sum;
+}
+
+static uint64_t
+item_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	return hash_int(hash_entry(e, struct ksm_item, elem)->sum);
+}
+
+static bool
+item_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	return hash_entry(a, struct ksm_item, elem)->sum < hash_entry(b, struct ksm_item, elem)->sum;
+}
+
+static void
+item_free(struct hash_elem *e, void *aux UNUSED)
+{
+	kmem_cache_free(item_cache, hash_entry(e, struct ksm_item, elem));
+}
+
+/* Initializes same-page merging and, if -ksm was given, starts
+ * ksmd. */
+void ksm_init(void)
+{
+	lock_init(&ksm_lock);
+	hash_init(&stable, entry_hash, entry_less, NULL);
+	hash_init(&unstable, item_hash, item_less, NULL);
+	list_init(&spt_list);
+	item_cache = kmem_cache_create("ksm_item", sizeof(struct ksm_item), NULL);
+	if (item_cache == NULL)
+	{
+		PANIC("ksm_init: cannot create object cache");
+	}
+	if (ksm_pages_to_scan > 0 && thread_create("ksmd", PRI_DEFAULT, ksmd, NULL) == TID_ERROR)
+	{
+		PANIC("ksm_init: cannot start ksmd");
+	}
+}
+
+/* Lets ksmd scan SPT. */
+void ksm_add(struct supplemental_page_table *spt)
+{
+	lock_acquire(&ksm_lock);
+	list_push_back(&spt_list, &spt->ksm_elem);
+	lock_release(&ksm_lock);
+}
+
+/* Stops ksmd from scanning SPT.  Once this returns, ksmd no longer
+ * refers to SPT. */
+void ksm_remove(struct supplemental_page_table *spt)
+{
+	lock_acquire(&ksm_lock);
+	if (cursor == spt)
+	{
+		// 다음 spt부터 이어서 훑는다.
+		struct list_elem *next = list_next(&spt->ksm_elem);
+		cursor = next != list_end(&spt_list) ? list_entry(next, struct supplemental_page_table, ksm_elem) : NULL;
+		cursor_va = NULL;
+	}
+	list_remove(&spt->ksm_elem);
+	lock_release(&ksm_lock);
+}
+
+/* Returns true if SPT is still scanned, that is, still belongs to a
+ * live process.  ksm_lock must be held. */
+static bool
+spt_listed(struct supplemental_page_table *spt)
+{
+	for (struct list_elem *e = list_begin(&spt_list); e != list_end(&spt_list); e = list_next(e))
+	{
+		if (list_entry(e, struct supplemental_page_table, ksm_elem) == spt)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Returns true if PAGE shares a merged frame with other pages. */
+bool ksm_is_merged(struct page *page)
+{
+	return VM_TYPE(page->operations->type) == VM_ANON && !is_shared_page(page) &&
+		   page->anon.ksm != NULL;
+}
+
+/* Checksum of the page at KVA. */
+static uint32_t
+page_sum(const void *kva)
+{
+	const uint64_t *w = kva;
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < PGSIZE / sizeof *w; i++)
+	{
+		h = (h ^ w[i]) * 1099511628211ULL;
+	}
+	return h ^ (h >> 32);
+}
+
+/* Returns true if PAGE, whose spt ksmd holds, is a resident anonymous
+ * page of its own that is not merged yet and is mapped by a 4 kB
+ * PTE.  Pages inside a huge mapping are left alone rather than
+ * splitting it, and pinned pages must keep their frame. */
+static bool
+ksm_candidate(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) != VM_ANON || is_shared_page(page) || page->frame == NULL ||
+		page->anon.ksm != NULL || is_pinned_page(page))
+	{
+		return false;
+	}
+	uint64_t *pte = pml4e_walk(page->owner->pml4, (uint64_t)page->va, 0);
+	return pte != NULL && (*pte & PTE_P) && !(*pte & PTE_PS);
+}
+
+/* Replace the mapping of PAGE with KVA.  The owner may be another
+ * process; pml4_clear_page() takes care of its TLB. */
+static void
+remap(struct page *page, void *kva, bool writable)
+{
+	pml4_clear_page(page->owner->pml4, page->va);
+	if (!pml4_set_page(page->owner->pml4, page->va, kva, writable))
+	{
+		// 방금 비운 PTE 자리라 페이지 테이블을 새로 만들 일이 없다.
+		PANIC("ksm: cannot remap page");
+	}
+}
+
+/* Merge PAGE into entry E if their contents are still the same.
+ * PAGE is unmapped before it is compared, so its owner cannot change
+ * it in between.  ksm_lock and the spt lock of PAGE must be held. */
+static bool
+ksm_merge(struct ksm_entry *e, struct page *page)
+{
+	void *kva = page->frame->kva;
+
+	pml4_clear_page(page->owner->pml4, page->va);
+	if (memcmp(kva, e->frame->kva, PGSIZE) != 0)
+	{
+		remap(page, kva, page->writable);
+		return false;
+	}
+	remap(page, e->frame->kva, false);
+	vm_free_frame(page->frame);
+	page->frame = e->frame;
+	page->anon.ksm = e;
+	list_push_back(&e->sharers, &page->anon.ksm_elem);
+	pages_merged++;
+	merges++;
+	return true;
+}
+
+/* Turn the frame of PAGE into a new stable entry whose contents sum
+ * up to SUM, write-protecting PAGE.  Returns NULL if the contents
+ * changed since they were summed.  ksm_lock and the spt lock of PAGE
+ * must be held. */
+static struct ksm_entry *
+ksm_promote(struct page *page, uint32_t sum)
+{
+	struct ksm_entry *e = malloc(sizeof *e);
+	if (e == NULL)
+	{
+		return NULL;
+	}
+	remap(page, page->frame->kva, false);
+	if (page_sum(page->frame->kva) != sum)
+	{
+		remap(page, page->frame->kva, page->writable);
+		free(e);
+		return NULL;
+	}
+	e->sum = sum;
+	e->frame = page->frame;
+	e->frame->page = page;
+	list_init(&e->sharers);
+	list_push_back(&e->sharers, &page->anon.ksm_elem);
+	page->anon.ksm = e;
+	hash_insert(&stable, &e->elem);
+	pages_merged++;
+	return e;
+}
+
+/* Detach PAGE from its entry.  If PAGE was the last sharer, the entry
+ * is freed and true is returned: the frame now belongs to PAGE alone.
+ * The mapping and PAGE->frame are left to the caller.  ksm_lock must
+ * be held. */
+static bool
+ksm_detach(struct page *page)
+{
+	struct ksm_entry *e = page->anon.ksm;
+
+	list_remove(&page->anon.ksm_elem);
+	page->anon.ksm = NULL;
+	pages_merged--;
+	unmerges++;
+	if (list_empty(&e->sharers))
+	{
+		hash_delete(&stable, &e->elem);
+		free(e);
+		return true;
+	}
+	if (e->frame->page == page)
+	{
+		// 대표 페이지를 살아 있는 다른 공유자로 바꾼다.
+		e->frame->page = list_entry(list_front(&e->sharers), struct page, anon.ksm_elem);
+	}
+	return false;
+}
+
+/* spt_apply() callback of ksm_scan(): look at PAGE, merging it with
+ * a stable frame or with a twin from the unstable table. */
+static bool
+scan_page(struct page *page, void *batch_)
+{
+	struct ksm_batch *b = batch_;
+	if (page->va < b->start || !ksm_candidate(page))
+	{
+		return true;
+	}
+	if (b->budget == 0)
+	{
+		b->next = page->va;
+		return false;
+	}
+	b->budget--;
+	pages_scanned++;
+
+	// 1. 이미 병합된 프레임 중에 같은 내용이 있으면 거기에 합친다.
+	uint32_t sum = page_sum(page->frame->kva);
+	struct ksm_entry ekey;
+	ekey.sum = sum;
+	struct hash_elem *found = hash_find(&stable, &ekey.elem);
+	if (found != NULL)
+	{
+		ksm_merge(hash_entry(found, struct ksm_entry, elem), page);
+		return true;
+	}
+
+	// 2. 지난 패스 이후 내용이 바뀐 페이지는 아직 건드리지 않는다.
+	if (sum != page->anon.ksm_sum)
+	{
+		page->anon.ksm_sum = sum;
+		return true;
+	}
+
+	// 3. 이번 패스에서 같은 체크섬을 가진 페이지를 봤으면 둘을 합친다.
+	struct ksm_item ikey;
+	ikey.sum = sum;
+	found = hash_find(&unstable, &ikey.elem);
+	if (found == NULL)
+	{
+		struct ksm_item *item = kmem_cache_alloc(item_cache);
+		if (item != NULL)
+		{
+			item->sum = sum;
+			item->spt = b->spt;
+			item->va = page->va;
+			hash_insert(&unstable, &item->elem);
+		}
+		return true;
+	}
+	struct ksm_item *item = hash_entry(found, struct ksm_item, elem);
+	struct supplemental_page_table *other = item->spt;
+	bool locked = other != b->spt && spt_listed(other) && lock_try_acquire(&other->lock);
+	bool merged = false;
+	if (other == b->spt || locked)
+	{
+		struct page *twin = spt_find_page(other, item->va);
+		if (twin != NULL && twin != page && ksm_candidate(twin))
+		{
+			struct ksm_entry *e = ksm_promote(twin, sum);
+			merged = e != NULL && ksm_merge(e, page);
+		}
+	}
+	if (locked)
+	{
+		lock_release(&other->lock);
+	}
+	if (merged)
+	{
+		hash_delete(&unstable, &item->elem);
+		kmem_cache_free(item_cache, item);
+	}
+	else
+	{
+		// 짝이 사라졌거나 내용이 달랐으면 이 페이지가 대신 기다린다.
+		item->spt = b->spt;
+		item->va = page->va;
+	}
+	return true;
+}
+
+/* Scan up to BUDGET anonymous pages, picking up where the last call
+ * left off.  Processes whose spt is busy are skipped. */
+static void
+ksm_scan(size_t budget)
+{
+	lock_acquire(&ksm_lock);
+	size_t tries = list_size(&spt_list);
+	while (budget > 0 && tries-- > 0)
+	{
+		if (cursor == NULL)
+		{
+			cursor = list_entry(list_front(&spt_list), struct supplemental_page_table, ksm_elem);
+			cursor_va = NULL;
+		}
+		struct ksm_batch b = {cursor, cursor_va, budget, NULL};
+		bool done = true;
+		if (lock_try_acquire(&cursor->lock))
+		{
+			done = spt_apply(cursor, scan_page, &b);
+			lock_release(&cursor->lock);
+			budget = b.budget;
+		}
+		if (!done)
+		{
+			cursor_va = b.next;
+			break;
+		}
+
+		// 이 spt는 끝났다. 마지막 spt였으면 한 패스가 끝난 것이다.
+		struct list_elem *next = list_next(&cursor->ksm_elem);
+		cursor_va = NULL;
+		if (next != list_end(&spt_list))
+		{
+			cursor = list_entry(next, struct supplemental_page_table, ksm_elem);
+		}
+		else
+		{
+			cursor = NULL;
+			full_scans++;
+			hash_clear(&unstable, item_free);
+		}
+	}
+	lock_release(&ksm_lock);
+}
+
+/* ksmd: scan ksm_pages_to_scan pages every ksm_sleep_ms
+ * milliseconds.  Together the two bound the CPU time it takes. */
+static void
+ksmd(void *aux UNUSED)
+{
+	for (;;)
+	{
+		if (!list_empty(&spt_list))
+		{
+			ksm_scan(ksm_pages_to_scan);
+		}
+		timer_msleep(ksm_sleep_ms);
+	}
+}
+
+/* Returns true if PAGE is the only page left mapping its merged
+ * frame.  ksm_lock must be held. */
+static bool
+sole_sharer(struct page *page)
+{
+	struct list *sharers = &page->anon.ksm->sharers;
+	return list_begin(sharers) == list_rbegin(sharers);
+}
+
+/* Give PAGE, a merged page of the current process that was written
+ * to, a private writable copy of its frame.  The last sharer just
+ * takes the frame over.  Returns false if no frame can be had for
+ * the copy.  The spt lock must be held. */
+bool ksm_break(struct page *page)
+{
+	struct frame *copy = NULL;
+
+	lock_acquire(&ksm_lock);
+	while (copy == NULL && page->anon.ksm != NULL && !sole_sharer(page))
+	{
+		// 프레임을 구하다 축출이 일어나면 ksm_lock이 필요하므로 놓고 구한다.
+		lock_release(&ksm_lock);
+		if ((copy = vm_get_frame()) == NULL)
+		{
+			// 내보낼 페이지도 없다. 폴트를 실패시킨다.
+			return false;
+		}
+		lock_acquire(&ksm_lock);
+	}
+	if (page->anon.ksm == NULL)
+	{
+		// 그 사이 이 페이지가 쫓겨났다. 다시 폴트가 나면 swap에서 읽어 온다.
+		lock_release(&ksm_lock);
+		if (copy != NULL)
+		{
+			vm_free_frame(copy);
+		}
+		return true;
+	}
+
+	struct frame *shared = page->frame;
+	if (ksm_detach(page))
+	{
+		shared->page = page;
+		shared->owner = page->owner;
+		remap(page, shared->kva, true);
+		if (copy != NULL)
+		{
+			vm_free_frame(copy);
+		}
+	}
+	else
+	{
+		memcpy(copy->kva, shared->kva, PGSIZE);
+		copy->page = page;
+		page->frame = copy;
+		remap(page, copy->kva, true);
+	}
+	lock_release(&ksm_lock);
+	return true;
+}
+
+/* Evict PAGE, a merged page of the current process, by writing it to
+ * a swap slot of its own.  Returns the frame if PAGE was its last
+ * sharer, or NULL if other pages still map it (or swap is full).
+ * The spt lock must be held. */
+struct frame *
+ksm_evict(struct page *page)
+{
+	// 공유 프레임은 아무도 쓸 수 없으니 락 없이 디스크에 써도 된다.
+	int slot = anon_swap_write(page->frame->kva);
+	if (slot < 0)
+	{
+		return NULL;
+	}
+
+	lock_acquire(&ksm_lock);
+	struct frame *frame = page->frame;
+	pml4_clear_page(page->owner->pml4, page->va);
+	bool last = ksm_detach(page);
+	vm_page_clear_frame(page);
+	page->anon.swap_slot = slot;
+	vm_account(&page->owner->swap_cnt, 1);
+	lock_release(&ksm_lock);
+	return last ? frame : NULL;
+}
+
+/* Detach PAGE, a merged page that is being destroyed, from its frame,
+ * freeing the frame if nobody else maps it.  The mapping is cleared
+ * here so that pml4_destroy() leaves the frame alone. */
+void ksm_destroy(struct page *page)
+{
+	lock_acquire(&ksm_lock);
+	struct frame *frame = page->frame;
+	vm_unmap_page(page);
+	if (ksm_detach(page))
+	{
+		vm_free_frame(frame);
+	}
+	page->frame = NULL;
+	lock_release(&ksm_lock);
+}
+
+/* Prints merging statistics. */
+void ksm_print_stats(void)
+{
+	size_t shared = hash_size(&stable);
+	printf("KSM: %zu frames shared by %zu pages (%zu saved), "
+		   "%zu merges, %zu unmerges, %zu pages scanned, %zu full scans\n",
+		   shared, pages_merged, pages_merged - shared, merges, unmerges,
+		   pages_scanned, full_scans);
+}
@@ -0,0 +1,294 @@
+/* madvise.c: Access-pattern hints for user memory.
+ *
+ * MADV_NORMAL, MADV_RANDOM and MADV_SEQUENTIAL are remembered in the
+ * regions the range overlaps, as a whole: regions are never split.
+ * The fault handler uses them to size its fault-around window and
+ * the eviction scan to pick pages of sequential regions first.
+ *
+ * MADV_WILLNEED creates the pages of the range and hands them to a
+ * kernel thread, which loads them into free frames in the
+ * background.  Like ksmd it never waits for a process's spt lock:
+ * a busy process is retried on the next tick.
+ *
+ * MADV_DONTNEED drops the contents of anonymous pages, which then
+ * read back as they were first loaded (zeros outside executable data
+ * segments), and frees the frames of clean file pages.  Pinned and
+ * shared pages are left alone. */
+
+#include "vm/madvise.h"
+#include "vm/vm.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <round.h>
+#include <user/syscall.h>
+
+/* Pages loaded per hold of a process's spt lock. */
+#define WILLNEED_BATCH 32
+
+/* Pages of one process still to be loaded by the worker. */
+struct willneed_req
+{
+	struct list_elem elem;
+	struct supplemental_page_table *spt;
+	void *va;  // 다음에 올릴 페이지
+	void *end; // 범위의 끝
+};
+
+static struct list req_list;
+static struct lock req_lock;
+static struct condition req_cond;  // 요청이 들어왔다
+static struct condition done_cond; // 워커가 busy_spt를 놓았다
+static struct supplemental_page_table *busy_spt;
+
+static void willneed_worker(void *aux);
+
+void madvise_init(void)
+{
+	list_init(&req_list);
+	lock_init(&req_lock);
+	cond_init(&req_cond);
+	cond_init(&done_cond);
+	if (thread_create("willneed", PRI_DEFAULT, willneed_worker, NULL) == TID_ERROR)
+	{
+		PANIC("madvise_init: cannot start willneed");
+	}
+}
+
+/* Load PAGE into a free frame without mapping it until its contents
+ * are in place.  Returns false if no frame is free or PAGE's owner
+ * has reached its rss limit. */
+static bool
+willneed_load(struct page *page)
+{
+	// 이 스레드의 상한이 아니라 페이지 주인의 상한을 본다.
+	struct frame *frame = vm_rss_over_limit(page->owner, 1) ? NULL : vm_try_get_frame();
+	if (frame == NULL)
+	{
+		return false;
+	}
+	frame->page = page;
+	frame->owner = page->owner;
+	vm_page_set_frame(page, frame);
+	// 내용을 다 읽은 뒤에 매핑해야 사용자가 읽다 만 페이지를 보지 않는다.
+	if (!swap_in(page, frame->kva) ||
+		!pml4_set_page(page->owner->pml4, page->va, frame->kva, page->writable))
+	{
+		vm_page_clear_frame(page);
+		vm_free_frame(frame);
+	}
+	return true;
+}
+
+/* Load up to WILLNEED_BATCH pages of REQ, whose spt lock the caller
+ * holds.  Returns false once the request is done. */
+static bool
+willneed_batch(struct willneed_req *req)
+{
+	for (int i = 0; i < WILLNEED_BATCH && req->va < req->end; i++, req->va += PGSIZE)
+	{
+		struct page *page = spt_get_page(req->spt, req->va);
+		if (page == NULL || page->frame != NULL || is_text_page(page) || is_shared_page(page))
+		{
+			continue;
+		}
+		// 남는 프레임이 없으면 더 올리지 않는다. 힌트일 뿐이라 쫓아내지는 않는다.
+		if (!willneed_load(page))
+		{
+			return false;
+		}
+	}
+	return req->va < req->end;
+}
+
+static void
+willneed_worker(void *aux UNUSED)
+{
+	for (;;)
+	{
+		lock_acquire(&req_lock);
+		while (list_empty(&req_list))
+		{
+			cond_wait(&req_cond, &req_lock);
+		}
+		struct willneed_req *req = list_entry(list_pop_front(&req_list),
+											  struct willneed_req, elem);
+		struct supplemental_page_table *spt = req->spt;
+		if (!lock_try_acquire(&spt->lock))
+		{
+			// 폴트 처리 중이면 다음 틱에 다시 본다.
+			list_push_back(&req_list, &req->elem);
+			lock_release(&req_lock);
+			timer_sleep(1);
+			continue;
+		}
+		busy_spt = spt;
+		lock_release(&req_lock);
+
+		bool more = willneed_batch(req);
+		lock_release(&spt->lock);
+
+		lock_acquire(&req_lock);
+		busy_spt = NULL;
+		cond_broadcast(&done_cond, &req_lock);
+		if (more)
+		{
+			list_push_back(&req_list, &req->elem);
+		}
+		else
+		{
+			free(req);
+		}
+		lock_release(&req_lock);
+	}
+}
+
+/* Drop every pending MADV_WILLNEED request for SPT, waiting for the
+ * worker if it is loading pages of SPT right now.  The caller must
+ * not hold SPT's lock unless the worker cannot be holding it. */
+void madvise_cancel(struct supplemental_page_table *spt)
+{
+	lock_acquire(&req_lock);
+	while (busy_spt == spt)
+	{
+		cond_wait(&done_cond, &req_lock);
+	}
+	struct list_elem *e = list_begin(&req_list);
+	while (e != list_end(&req_list))
+	{
+		struct willneed_req *req = list_entry(e, struct willneed_req, elem);
+		e = list_next(e);
+		if (req->spt == spt)
+		{
+			list_remove(&req->elem);
+			free(req);
+		}
+	}
+	lock_release(&req_lock);
+}
+
+/* Create the pages of [START, END) that do not exist yet and queue
+ * them for the worker. */
+static int
+madvise_willneed(struct supplemental_page_table *spt, void *start, void *end)
+{
+	for (void *va = start; va < end; va += PGSIZE)
+	{
+		if (spt_get_page(spt, va) == NULL)
+		{
+			region_populate(spt, va);
+		}
+	}
+	struct willneed_req *req = malloc(sizeof *req);
+	if (req == NULL)
+	{
+		return 0;
+	}
+	req->spt = spt;
+	req->va = start;
+	req->end = end;
+	lock_acquire(&req_lock);
+	list_push_back(&req_list, &req->elem);
+	cond_signal(&req_cond, &req_lock);
+	lock_release(&req_lock);
+	return 0;
+}
+
+/* Drop the contents of the pages of [START, END). */
+static int
+madvise_dontneed(struct supplemental_page_table *spt, void *start, void *end)
+{
+	struct thread *cur = thread_current();
+	struct mmu_gather tlb;
+	mmu_gather_init(&tlb, cur->pml4);
+	spt->tlb = &tlb;
+	for (void *va = start; va < end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+		// mlock()되었거나 입출력 중인 페이지, 다른 프로세스와 같이 쓰는 페이지는 그대로 둔다.
+		if (page == NULL || is_pinned_page(page) || is_shared_page(page))
+		{
+			continue;
+		}
+		switch (VM_TYPE(page->operations->type))
+		{
+		case VM_ANON:
+			anon_discard(page);
+			// 영역에 속한 페이지는 지워 두면 다음 폴트 때 처음 내용으로 다시 만들어진다.
+			if (region_find(spt, va) != NULL)
+			{
+				spt_remove_page(spt, page);
+			}
+			break;
+		case VM_FILE:
+			// 깨끗한 파일 페이지만 내려놓는다. 더러운 페이지를 버리면 쓴 내용이 사라진다.
+			if (page->frame != NULL && !is_text_page(page) &&
+				!pml4_is_dirty(cur->pml4, va))
+			{
+				vm_unmap_page(page);
+				vm_free_frame(page->frame);
+				vm_page_clear_frame(page);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	spt->tlb = NULL;
+	mmu_gather_finish(&tlb);
+	return 0;
+}
+
+/* Record ADVICE in every region overlapping [START, END). */
+static int
+madvise_set(struct supplemental_page_table *spt, void *start, void *end, int advice)
+{
+	for (void *va = start; va < end; va += PGSIZE)
+	{
+		struct vm_region *region = region_find(spt, va);
+		if (region != NULL)
+		{
+			region->advice = advice;
+			va = region->end - PGSIZE;
+		}
+	}
+	return 0;
+}
+
+/* Apply ADVICE to the LENGTH bytes of user memory at ADDR, which
+ * must be page-aligned.  Returns 0 on success, -1 on bad
+ * arguments. */
+int do_madvise(void *addr, size_t length, int advice)
+{
+	void *end = addr + ROUND_UP(length, PGSIZE);
+	if (addr == NULL || pg_ofs(addr) != 0 || length == 0 || end <= addr ||
+		!is_user_vaddr(end - 1))
+	{
+		return -1;
+	}
+	if (advice < MADV_NORMAL || advice > MADV_DONTNEED)
+	{
+		return -1;
+	}
+
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	int result;
+	lock_acquire(&spt->lock);
+	switch (advice)
+	{
+	case MADV_WILLNEED:
+		result = madvise_willneed(spt, addr, end);
+		break;
+	case MADV_DONTNEED:
+		result = madvise_dontneed(spt, addr, end);
+		break;
+	default:
+		result = madvise_set(spt, addr, end, advice);
+		break;
+	}
+	lock_release(&spt->lock);
+	return result;
+}
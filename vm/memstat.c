@@ -0,0 +1,79 @@
+/* memstat.c: Per-process memory accounting.
+ *
+ * Every thread counts the pages it has in frames (rss) and in swap,
+ * and the page faults it resolved.  The counters are kept up to date
+ * where pages are linked to and unlinked from frames and swap slots
+ * (vm_page_set_frame(), vm_page_clear_frame(), vm_account()).
+ *
+ * A process may be given an rss limit.  Once it reaches the limit it
+ * no longer takes free frames: every new page evicts one of its own,
+ * so a runaway process pages against itself instead of pushing every
+ * other process into swap.  The limit is inherited across fork().
+ *
+ * memstat(), faultstat() and set_rss_limit() work on the calling
+ * process (PID 0 or its own pid) and on its children, so that a
+ * supervisor can watch and cap the processes it started. */
+
+#include "vm/memstat.h"
+#include "vm/faultstat.h"
+#include "threads/thread.h"
+
+/* Returns the thread of process PID, which must be 0 or the current
+ * process or one of its children, or NULL. */
+static struct thread *
+find_process(pid_t pid)
+{
+	struct thread *cur = thread_current();
+	return pid == 0 || pid == cur->tid ? cur : get_child_process(pid);
+}
+
+/* Store the memory counters of process PID in ST.  Returns 0, or -1
+ * if PID is not the current process or one of its children. */
+int do_memstat(pid_t pid, struct memstat *st)
+{
+	struct thread *t = find_process(pid);
+	if (t == NULL)
+	{
+		return -1;
+	}
+	st->rss = t->rss;
+	st->rss_limit = t->rss_limit;
+	st->swap = t->swap_cnt;
+	st->faults = t->fault_cnt;
+	st->major_faults = t->major_fault_cnt;
+	return 0;
+}
+
+/* Store the page fault counts and cycle totals of process PID, and
+ * the system-wide latency histograms, in ST.  Returns 0, or -1 if
+ * PID is not the current process or one of its children. */
+int do_faultstat(pid_t pid, struct faultstat *st)
+{
+	struct thread *t = find_process(pid);
+	if (t == NULL)
+	{
+		return -1;
+	}
+	for (int kind = 0; kind < FAULT_KIND_CNT; kind++)
+	{
+		st->count[kind] = t->fault_kind_cnt[kind];
+		st->cycles[kind] = t->fault_cycles[kind];
+	}
+	faultstat_fill_hist(st);
+	return 0;
+}
+
+/* Limit process PID to PAGES resident pages, or lift the limit if
+ * PAGES is 0.  A process already above the new limit shrinks as it
+ * faults.  Returns 0, or -1 if PID is not the current process or one
+ * of its children. */
+int do_set_rss_limit(pid_t pid, size_t pages)
+{
+	struct thread *t = find_process(pid);
+	if (t == NULL)
+	{
+		return -1;
+	}
+	t->rss_limit = pages;
+	return 0;
+}
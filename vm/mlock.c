@@ -0,0 +1,217 @@
+/* mlock.c: Pages that must stay in memory.
+ *
+ * mlock() brings the pages of a range in and marks them locked;
+ * the eviction scan, swap clustering, ksmd and MADV_DONTNEED all
+ * leave locked pages alone until munlock() or until they are
+ * unmapped.  A locked text or shared memory page also pins its
+ * frame, since the other processes mapping that frame could evict it
+ * for all of them.  A process may lock at most a quarter of the user
+ * pool, so that eviction always has something left to work with.
+ *
+ * The kernel pins frames for the length of an I/O on a user buffer
+ * (vm_pin_range()) so that the buffer is not evicted, merged or
+ * dropped under the transfer.  Pins are counted per frame and never
+ * outlive the system call that took them. */
+
+#include "vm/mlock.h"
+#include "vm/vm.h"
+#include "vm/ksm.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <bitmap.h>
+#include <round.h>
+
+/* Returns true if PAGE maps a frame that other processes map too:
+ * a text page or a shared memory page.  Another sharer may evict
+ * such a frame, so locking PAGE pins the frame itself. */
+static bool
+maps_shared_frame(struct page *page)
+{
+	return is_text_page(page) || is_shared_page(page);
+}
+
+/* Bring PAGE into a frame of its own.  A merged page gets a private
+ * copy, since its shared frame cannot be held for one sharer. */
+static bool
+make_resident(struct page *page)
+{
+	if (ksm_is_merged(page) && !ksm_break(page))
+	{
+		return false;
+	}
+	return page->frame != NULL || vm_do_claim_page(page);
+}
+
+/* Mark PAGE of SPT, which is resident, locked. */
+static void
+lock_page(struct supplemental_page_table *spt, struct page *page)
+{
+	// 공유 프레임은 다른 공유자가 내보낼 수 있으므로 프레임 자체를 고정한다.
+	if (maps_shared_frame(page))
+	{
+		page->frame->pin_cnt++;
+	}
+	page->locked = true;
+	spt->locked_cnt++;
+}
+
+/* Undo lock_page(). */
+static void
+unlock_page(struct supplemental_page_table *spt, struct page *page)
+{
+	if (maps_shared_frame(page))
+	{
+		page->frame->pin_cnt--;
+	}
+	page->locked = false;
+	spt->locked_cnt--;
+}
+
+/* Returns false if [ADDR, ADDR + LENGTH) is not page-aligned user
+ * memory, setting *END to its end otherwise. */
+static bool
+check_range(void *addr, size_t length, void **end)
+{
+	*end = addr + ROUND_UP(length, PGSIZE);
+	return addr != NULL && pg_ofs(addr) == 0 && length > 0 && *end > addr &&
+		   is_user_vaddr(*end - 1);
+}
+
+/* Lock the LENGTH bytes of user memory at ADDR into memory.  Returns
+ * 0 on success, -1 if the range is bad, not mapped, would take the
+ * process over its limit, or cannot be brought in.  On failure no
+ * page is left locked by this call. */
+int do_mlock(void *addr, size_t length)
+{
+	void *end;
+	if (!check_range(addr, length, &end))
+	{
+		return -1;
+	}
+
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	size_t page_cnt = (end - addr) / PGSIZE;
+	// 실패하면 되돌릴 수 있게 이번 호출이 잠근 페이지를 표시해 둔다.
+	struct bitmap *locked_here = bitmap_create(page_cnt);
+	if (locked_here == NULL)
+	{
+		return -1;
+	}
+	int result = -1;
+	lock_acquire(&spt->lock);
+	// 먼저 범위 전체가 매핑되어 있는지, 한도를 넘지 않는지 본다. 실패해도 페이지가 남지 않게 아직 만들지 않는다.
+	size_t new_cnt = 0;
+	for (void *va = addr; va < end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+		if (page == NULL && region_find(spt, va) == NULL)
+		{
+			goto done;
+		}
+		new_cnt += page == NULL || !page->locked;
+	}
+	if (spt->locked_cnt + new_cnt > palloc_user_pages() / 4)
+	{
+		goto done;
+	}
+
+	for (size_t i = 0; i < page_cnt; i++)
+	{
+		struct page *page = spt_get_page(spt, addr + i * PGSIZE);
+		if (page == NULL || (!page->locked && !make_resident(page)))
+		{
+			// 중간에 실패하면 이번 호출이 잠근 페이지를 모두 풀어 한도도 되돌린다.
+			for (size_t j = 0; j < i; j++)
+			{
+				if (bitmap_test(locked_here, j))
+				{
+					unlock_page(spt, spt_find_page(spt, addr + j * PGSIZE));
+				}
+			}
+			goto done;
+		}
+		if (!page->locked)
+		{
+			lock_page(spt, page);
+			bitmap_mark(locked_here, i);
+		}
+	}
+	result = 0;
+done:
+	lock_release(&spt->lock);
+	bitmap_destroy(locked_here);
+	return result;
+}
+
+/* Let the pages of the LENGTH bytes at ADDR be evicted again.
+ * Returns 0 on success, -1 if the range is bad. */
+int do_munlock(void *addr, size_t length)
+{
+	void *end;
+	if (!check_range(addr, length, &end))
+	{
+		return -1;
+	}
+
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	lock_acquire(&spt->lock);
+	// 건드린 적 없는 페이지는 잠겨 있을 리 없으니 만들지 않고 건너뛴다.
+	for (void *va = addr; va < end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+		if (page != NULL && page->locked)
+		{
+			unlock_page(spt, page);
+		}
+	}
+	lock_release(&spt->lock);
+	return 0;
+}
+
+/* Pin the frames under the SIZE bytes at ADDR, at most PIN_MAX_PAGES
+ * pages, for an I/O that reads them or, if WRITE, writes them.  The
+ * frames are stored in PINS and their number returned; pass both to
+ * vm_unpin_frames() once the I/O is done.  Pages that cannot be
+ * pinned, such as unmapped or read-only ones, are skipped: the I/O
+ * then faults on them as it would without pinning. */
+size_t vm_pin_range(void *addr, size_t size, bool write, struct frame *pins[])
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	size_t cnt = 0;
+
+	if (size == 0 || !is_user_vaddr(addr))
+	{
+		return 0;
+	}
+	lock_acquire(&spt->lock);
+	for (void *va = pg_round_down(addr); va < addr + size && cnt < PIN_MAX_PAGES; va += PGSIZE)
+	{
+		if (!is_user_vaddr(va))
+		{
+			break;
+		}
+		struct page *page = spt_get_page(spt, va);
+		if (page == NULL || (write && !page->writable) || !make_resident(page))
+		{
+			continue;
+		}
+		page->frame->pin_cnt++;
+		pins[cnt++] = page->frame;
+	}
+	lock_release(&spt->lock);
+	return cnt;
+}
+
+/* Drop the pins taken by vm_pin_range(). */
+void vm_unpin_frames(struct frame *pins[], size_t cnt)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	lock_acquire(&spt->lock);
+	for (size_t i = 0; i < cnt; i++)
+	{
+		ASSERT(pins[i]->pin_cnt > 0);
+		pins[i]->pin_cnt--;
+	}
+	lock_release(&spt->lock);
+}
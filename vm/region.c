@@ -0,0 +1,234 @@
+/* region.c: Address-space regions.
+ *
+ * Executable segments, mmap()s and the stack are recorded as
+ * regions, kept in a red-black tree per process and ordered so that
+ * overlapping regions compare equal.  Mapping costs one region no
+ * matter how long it is; the struct page and load_info of a page are
+ * only created when the page is first touched. */
+
+#include "vm/vm.h"
+#include "vm/region.h"
+#include "vm/writeback.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <round.h>
+#include <user/syscall.h>
+
+/* Regions are ordered by address.  A ends before B starts, so two
+ * regions are "equal" exactly when they overlap. */
+static bool
+region_less_func(const struct rb_elem *a, const struct rb_elem *b, void *aux UNUSED)
+{
+	const struct vm_region *x = rb_entry(a, struct vm_region, elem);
+	const struct vm_region *y = rb_entry(b, struct vm_region, elem);
+	return x->end <= y->start;
+}
+
+void region_table_init(struct supplemental_page_table *spt)
+{
+	rb_init(&spt->regions, region_less_func, NULL);
+}
+
+/* Add the region [START, END) to SPT without checking the range.
+ * Returns NULL if it overlaps another region. */
+static struct vm_region *
+region_add(struct supplemental_page_table *spt, void *start, void *end,
+		   enum vm_type type, bool writable, struct file *file, off_t offset,
+		   size_t file_bytes, vm_initializer *init)
+{
+	struct vm_region *region = malloc(sizeof *region);
+	if (region == NULL)
+	{
+		return NULL;
+	}
+	region->start = start;
+	region->end = end;
+	region->type = type;
+	region->writable = writable;
+	region->mmap = false;
+	region->offset = offset;
+	region->file_bytes = file_bytes;
+	region->init = init;
+	region->advice = MADV_NORMAL;
+	region->shm = NULL;
+	region->file = NULL;
+
+	// 겹치는 구역이 있으면 트리가 그 구역을 돌려준다.
+	if (rb_insert(&spt->regions, &region->elem) != NULL)
+	{
+		free(region);
+		return NULL;
+	}
+	if (file != NULL && (region->file = file_reopen(file)) == NULL)
+	{
+		rb_remove(&spt->regions, &region->elem);
+		free(region);
+		return NULL;
+	}
+	return region;
+}
+
+/* Add a region of LENGTH bytes at START to SPT.  Its first
+ * FILE_BYTES bytes come from FILE at OFFSET and the rest reads as
+ * zeros; pages are created as TYPE with INIT as their loader.
+ * Returns NULL if the range is not page-aligned user memory, meets
+ * the stack area, or overlaps another region. */
+struct vm_region *
+region_create(struct supplemental_page_table *spt, void *start, size_t length,
+			  enum vm_type type, bool writable, struct file *file, off_t offset,
+			  size_t file_bytes, vm_initializer *init)
+{
+	void *end = start + ROUND_UP(length, PGSIZE);
+
+	if (pg_ofs(start) != 0 || length == 0 || end <= start || !is_user_vaddr(end - 1))
+	{
+		return NULL;
+	}
+	// 스택이 자랄 수 있는 구역과는 겹치지 않게 한다.
+	if (end > (void *)(USER_STACK - MAX_STACK_SIZE) && start < (void *)USER_STACK)
+	{
+		return NULL;
+	}
+	return region_add(spt, start, end, type, writable, file, offset, file_bytes, init);
+}
+
+/* Add the stack region of SPT: the MAX_STACK_SIZE bytes below
+ * USER_STACK, whose zero-filled pages the fault handler creates one
+ * at a time as the stack grows into them. */
+struct vm_region *
+region_create_stack(struct supplemental_page_table *spt)
+{
+	return region_add(spt, (void *)(USER_STACK - MAX_STACK_SIZE), (void *)USER_STACK,
+					  VM_ANON | VM_STACK, true, NULL, 0, 0, NULL);
+}
+
+/* Returns the region of SPT containing VA, or NULL. */
+struct vm_region *
+region_find(struct supplemental_page_table *spt, void *va)
+{
+	struct vm_region key;
+	key.start = pg_round_down(va);
+	key.end = key.start + 1;
+
+	struct rb_elem *e = rb_find(&spt->regions, &key.elem);
+	return e != NULL ? rb_entry(e, struct vm_region, elem) : NULL;
+}
+
+/* Build the load_info of the page at VA of REGION. */
+struct load_info *
+region_load_info(struct vm_region *region, void *va)
+{
+	struct load_info *info = kmem_cache_alloc(load_info_cache);
+	if (info == NULL)
+	{
+		return NULL;
+	}
+	size_t ofs = pg_round_down(va) - region->start;
+	size_t left = region->file_bytes > ofs ? region->file_bytes - ofs : 0;
+
+	info->file = region->file;
+	info->offset = region->offset + ofs;
+	info->read_bytes = left < PGSIZE ? left : PGSIZE;
+	info->zero_bytes = PGSIZE - info->read_bytes;
+	info->writable = region->writable;
+	return info;
+}
+
+/* Create the page at VA from the region that covers it.  Returns
+ * the new page, or NULL if VA is in no region. */
+struct page *
+region_populate(struct supplemental_page_table *spt, void *va)
+{
+	struct vm_region *region = region_find(spt, va);
+	if (region == NULL)
+	{
+		return NULL;
+	}
+	// 파일이 없는 구역(스택, 익명 mmap)의 페이지는 0으로 채운 익명 페이지로 시작한다.
+	// 코드 페이지는 로더 없이도 load_info로 텍스트 캐시를 찾으니 파일 구역이면 늘 만든다.
+	// 공유 메모리 페이지는 공유 객체에서 내용을 받으므로 만들지 않는다.
+	struct load_info *info = NULL;
+	if (region->file != NULL && region->shm == NULL && (info = region_load_info(region, va)) == NULL)
+	{
+		return NULL;
+	}
+	va = pg_round_down(va);
+	if (!vm_alloc_page_with_initializer(region->type, va, region->writable, region->init, info))
+	{
+		if (info != NULL)
+		{
+			kmem_cache_free(load_info_cache, info);
+		}
+		return NULL;
+	}
+	return spt_find_page(spt, va);
+}
+
+/* Remove REGION and every page created in it from SPT, which must
+ * be the current thread's.  Dirty file pages are written back in
+ * offset order, adjacent ones together, before the region's file is
+ * closed; the TLB is flushed once per batch of pages. */
+void region_destroy(struct supplemental_page_table *spt, struct vm_region *region)
+{
+	struct mmu_gather tlb;
+	struct writeback wb;
+	mmu_gather_init(&tlb, thread_current()->pml4);
+	writeback_init(&wb);
+	spt->tlb = &tlb;
+	spt->wb = &wb;
+	for (void *va = region->start; va < region->end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+		if (page != NULL)
+		{
+			spt_remove_page(spt, page);
+		}
+	}
+	writeback_finish(&wb);
+	spt->wb = NULL;
+	spt->tlb = NULL;
+	mmu_gather_finish(&tlb);
+	rb_remove(&spt->regions, &region->elem);
+	file_close(region->file);
+	shm_put(region->shm);
+	free(region);
+}
+
+/* Duplicate the regions of SRC into DST, for fork. */
+bool region_table_copy(struct supplemental_page_table *dst,
+					   struct supplemental_page_table *src)
+{
+	for (struct rb_elem *e = rb_first(&src->regions); e != NULL; e = rb_next(e))
+	{
+		struct vm_region *r = rb_entry(e, struct vm_region, elem);
+		struct vm_region *copy = region_add(dst, r->start, r->end, r->type, r->writable,
+											r->file, r->offset, r->file_bytes, r->init);
+		if (copy == NULL)
+		{
+			return false;
+		}
+		copy->mmap = r->mmap;
+		copy->advice = r->advice;
+		if ((copy->shm = r->shm) != NULL)
+		{
+			shm_get(copy->shm);
+		}
+	}
+	return true;
+}
+
+/* Free every region of SPT.  The pages must already be gone. */
+void region_table_kill(struct supplemental_page_table *spt)
+{
+	while (!rb_empty(&spt->regions))
+	{
+		struct vm_region *r = rb_entry(rb_first(&spt->regions), struct vm_region, elem);
+		rb_remove(&spt->regions, &r->elem);
+		file_close(r->file);
+		shm_put(r->shm);
+		free(r);
+	}
+}
@@ -0,0 +1,601 @@
+/* shm.c: Memory shared between processes.
+ *
+ * A shared memory object is either anonymous, made by shm_create(),
+ * or a file mapped with MAP_SHARED.  Every page of an object that
+ * has been touched has a slot holding its one frame, and every
+ * process that maps the page maps that frame, much like the text
+ * cache in file.c but writable.  Processes find an anonymous object
+ * through a file descriptor of their own (inherited over fork) and a
+ * file object through the file's inode.
+ *
+ * Evicting a shared page evicts it for all sharers at once: the
+ * frame is unmapped from each of them, and it is written back, to
+ * swap for an anonymous object or to the file if any sharer dirtied
+ * it.  A file page is also written back and dropped when its last
+ * sharer unmaps it.  An anonymous page keeps its frame while the
+ * object lives, since nothing else holds its contents.
+ *
+ * Only one sharer reads a page in or writes it back at a time.  The
+ * slot is marked busy for the duration, with its frame unmapped from
+ * every sharer, and sharers that fault on it meanwhile sleep until
+ * the I/O is done instead of issuing their own.
+ *
+ * shm_lock covers the objects, their slots and the sharer lists.
+ * It is taken inside the spt lock, and never held across eviction
+ * or disk I/O. */
+
+#include "vm/shm.h"
+#include "vm/vm.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <hash.h>
+#include <round.h>
+#include <string.h>
+
+/* An anonymous shared memory object or a file mapped shared. */
+struct shm_object
+{
+	struct hash_elem elem; // 파일 객체면 files 해시용
+	struct inode *inode;   // 파일 객체면 그 inode, 익명이면 NULL
+	struct file *file;	   // 파일 객체가 읽고 쓸 때 쓰는, 다시 연 파일
+	size_t size;		   // 익명 객체의 크기 (바이트)
+	struct hash slots;	   // 한 번이라도 건드린 페이지들
+	int ref_cnt;		   // 이 객체를 매핑한 구역 수 + 열린 fd 수
+};
+
+/* One page of a shared memory object. */
+struct shm_slot
+{
+	struct hash_elem elem;
+	struct shm_object *obj;
+	size_t idx;			   // 객체 안에서 몇 번째 페이지인지
+	struct frame *frame;   // 올라와 있는 공유 프레임, 없으면 NULL
+	bool busy;			   // 어떤 프로세스가 이 페이지를 읽거나 쓰는 중이다
+	struct condition idle; // 그 입출력이 끝나길 기다리는 폴트들
+	int swap_slot;		   // 익명 객체의 페이지가 내려가 있는 swap 슬롯, 없으면 -1
+	bool dirty;			   // 이미 매핑을 푼 공유자가 쓴 적이 있다
+	struct list sharers;   // 지금 프레임을 매핑하고 있는 페이지들
+};
+
+static bool shm_swap_in(struct page *page, void *kva);
+static bool shm_swap_out(struct page *page);
+static void shm_destroy(struct page *page);
+
+static const struct page_operations shm_anon_ops = {
+	.swap_in = shm_swap_in,
+	.swap_out = shm_swap_out,
+	.destroy = shm_destroy,
+	.type = VM_ANON | VM_SHARED,
+};
+
+static const struct page_operations shm_file_ops = {
+	.swap_in = shm_swap_in,
+	.swap_out = shm_swap_out,
+	.destroy = shm_destroy,
+	.type = VM_FILE | VM_SHARED,
+};
+
+static struct hash files; // inode로 찾는 파일 객체들
+static struct lock shm_lock;
+
+static uint64_t
+slot_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	struct shm_slot *s = hash_entry(e, struct shm_slot, elem);
+	return hash_int(s->idx);
+}
+
+static bool
+slot_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	return hash_entry(a, struct shm_slot, elem)->idx < hash_entry(b, struct shm_slot, elem)->idx;
+}
+
+static uint64_t
+file_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	struct shm_object *o = hash_entry(e, struct shm_object, elem);
+	return hash_bytes(&o->inode, sizeof o->inode);
+}
+
+static bool
+file_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	return hash_entry(a, struct shm_object, elem)->inode < hash_entry(b, struct shm_object, elem)->inode;
+}
+
+void shm_init(void)
+{
+	hash_init(&files, file_hash, file_less, NULL);
+	lock_init(&shm_lock);
+}
+
+/* Make a new object with one reference.  FILE is NULL for an
+ * anonymous object of SIZE bytes. */
+static struct shm_object *
+object_create(struct file *file, size_t size)
+{
+	struct shm_object *obj = malloc(sizeof *obj);
+	if (obj == NULL)
+	{
+		return NULL;
+	}
+	if (!hash_init(&obj->slots, slot_hash, slot_less, NULL))
+	{
+		free(obj);
+		return NULL;
+	}
+	obj->inode = NULL;
+	obj->file = NULL;
+	if (file != NULL && (obj->file = file_reopen(file)) == NULL)
+	{
+		hash_destroy(&obj->slots, NULL);
+		free(obj);
+		return NULL;
+	}
+	if (obj->file != NULL)
+	{
+		obj->inode = file_get_inode(obj->file);
+	}
+	obj->size = size;
+	obj->ref_cnt = 1;
+	return obj;
+}
+
+/* hash_destroy() callback of shm_put(): free a slot nobody maps. */
+static void
+slot_free(struct hash_elem *e, void *aux UNUSED)
+{
+	struct shm_slot *slot = hash_entry(e, struct shm_slot, elem);
+	ASSERT(list_empty(&slot->sharers));
+	if (slot->frame != NULL)
+	{
+		vm_free_frame(slot->frame);
+	}
+	if (slot->swap_slot >= 0)
+	{
+		anon_swap_drop(slot->swap_slot);
+	}
+	free(slot);
+}
+
+void shm_get(struct shm_object *obj)
+{
+	lock_acquire(&shm_lock);
+	obj->ref_cnt++;
+	lock_release(&shm_lock);
+}
+
+/* Drop a reference to OBJ, which may be NULL.  The last one frees
+ * the object along with the frames and swap slots of its pages. */
+void shm_put(struct shm_object *obj)
+{
+	if (obj == NULL)
+	{
+		return;
+	}
+	lock_acquire(&shm_lock);
+	if (--obj->ref_cnt > 0)
+	{
+		lock_release(&shm_lock);
+		return;
+	}
+	if (obj->inode != NULL)
+	{
+		hash_delete(&files, &obj->elem);
+	}
+	lock_release(&shm_lock);
+	hash_destroy(&obj->slots, slot_free);
+	file_close(obj->file);
+	free(obj);
+}
+
+/* Create an anonymous shared memory object of SIZE bytes and return
+ * a file descriptor for it, or -1. */
+int shm_create(size_t size)
+{
+	struct thread *cur = thread_current();
+	if (size == 0 || size > (size_t)(USER_STACK - MAX_STACK_SIZE))
+	{
+		return -1;
+	}
+	for (int i = 0; i < SHM_FD_CNT; i++)
+	{
+		if (cur->shm_fds[i] == NULL)
+		{
+			cur->shm_fds[i] = object_create(NULL, ROUND_UP(size, PGSIZE));
+			return cur->shm_fds[i] != NULL ? SHM_FD_BASE + i : -1;
+		}
+	}
+	return -1;
+}
+
+/* Returns the object open as FD in the current process, or NULL. */
+static struct shm_object *
+fd_object(int fd)
+{
+	return shm_is_fd(fd) ? thread_current()->shm_fds[fd - SHM_FD_BASE] : NULL;
+}
+
+/* Returns true if FD is in the range of shared memory descriptors. */
+bool shm_is_fd(int fd)
+{
+	return fd >= SHM_FD_BASE && fd < SHM_FD_BASE + SHM_FD_CNT;
+}
+
+void shm_close(int fd)
+{
+	struct shm_object *obj = fd_object(fd);
+	if (obj != NULL)
+	{
+		thread_current()->shm_fds[fd - SHM_FD_BASE] = NULL;
+		shm_put(obj);
+	}
+}
+
+/* Give CHILD the shared memory descriptors of PARENT. */
+void shm_fork(struct thread *parent, struct thread *child)
+{
+	for (int i = 0; i < SHM_FD_CNT; i++)
+	{
+		if ((child->shm_fds[i] = parent->shm_fds[i]) != NULL)
+		{
+			shm_get(child->shm_fds[i]);
+		}
+	}
+}
+
+void shm_close_all(void)
+{
+	for (int i = 0; i < SHM_FD_CNT; i++)
+	{
+		shm_close(SHM_FD_BASE + i);
+	}
+}
+
+/* Add a region mapping OBJ, taking a reference for it. */
+static void *
+map_object(void *addr, size_t length, bool writable, struct shm_object *obj,
+		   off_t offset, enum vm_type type)
+{
+	struct vm_region *region = region_create(&thread_current()->spt, addr, length, type,
+											 writable, obj->file, offset, 0, NULL);
+	if (region == NULL)
+	{
+		return NULL;
+	}
+	region->mmap = true;
+	region->shm = obj;
+	shm_get(obj);
+	return addr;
+}
+
+/* Map LENGTH bytes of the anonymous object open as FD, from OFFSET,
+ * at ADDR.  Returns ADDR, or NULL on failure. */
+void *shm_mmap(void *addr, size_t length, bool writable, int fd, off_t offset)
+{
+	struct shm_object *obj = fd_object(fd);
+	if (obj == NULL || offset < 0 || offset % PGSIZE != 0 ||
+		(size_t)offset + length > obj->size)
+	{
+		return NULL;
+	}
+	return map_object(addr, length, writable, obj, offset, VM_ANON | VM_SHARED);
+}
+
+/* Map LENGTH bytes of FILE, from OFFSET, at ADDR so that writes are
+ * seen by every process mapping the same file shared, and reach the
+ * file.  Returns ADDR, or NULL on failure. */
+void *shm_mmap_file(void *addr, size_t length, bool writable, struct file *file,
+					off_t offset)
+{
+	if (file_length(file) <= 0)
+	{
+		return NULL;
+	}
+	struct shm_object key;
+	key.inode = file_get_inode(file);
+
+	lock_acquire(&shm_lock);
+	struct hash_elem *e = hash_find(&files, &key.elem);
+	struct shm_object *obj = e != NULL ? hash_entry(e, struct shm_object, elem) : NULL;
+	if (obj != NULL)
+	{
+		obj->ref_cnt++;
+	}
+	else if ((obj = object_create(file, 0)) != NULL)
+	{
+		hash_insert(&files, &obj->elem);
+	}
+	lock_release(&shm_lock);
+	if (obj == NULL)
+	{
+		return NULL;
+	}
+	// 찾거나 만들 때 잡은 참조는 구역이 따로 잡으므로 놓는다.
+	void *result = map_object(addr, length, writable, obj, offset, VM_FILE | VM_SHARED);
+	shm_put(obj);
+	return result;
+}
+
+/* Number of file bytes in the page of SLOT. */
+static size_t
+file_bytes(struct shm_slot *slot)
+{
+	off_t ofs = slot->idx * PGSIZE;
+	off_t len = file_length(slot->obj->file);
+	return ofs >= len ? 0 : len - ofs < PGSIZE ? len - ofs : PGSIZE;
+}
+
+/* Returns true if the page of SLOT was written since it was last
+ * written back.  shm_lock must be held. */
+static bool
+slot_dirty(struct shm_slot *slot)
+{
+	if (slot->dirty)
+	{
+		return true;
+	}
+	for (struct list_elem *e = list_begin(&slot->sharers); e != list_end(&slot->sharers);
+		 e = list_next(e))
+	{
+		struct page *p = list_entry(e, struct page, shared.elem);
+		if (pml4_is_dirty(p->owner->pml4, p->va))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Read the contents of SLOT into KVA, from the file or from swap.
+ * A page of an anonymous object never written out stays zero. */
+static bool
+slot_read(struct shm_slot *slot, void *kva)
+{
+	if (slot->obj->inode != NULL)
+	{
+		size_t bytes = file_bytes(slot);
+		if (file_read_at(slot->obj->file, kva, bytes, slot->idx * PGSIZE) != (int)bytes)
+		{
+			return false;
+		}
+		memset(kva + bytes, 0, PGSIZE - bytes);
+	}
+	else if (slot->swap_slot >= 0)
+	{
+		anon_swap_read(slot->swap_slot, kva);
+	}
+	return true;
+}
+
+/* Turn the uninit shared page PAGE into a shared page attached to
+ * the slot of its object, creating the slot if this is the first
+ * time any process touches it. */
+static bool
+shm_attach(struct page *page)
+{
+	struct vm_region *region = region_find(&page->owner->spt, page->va);
+	if (region == NULL || region->shm == NULL)
+	{
+		return false;
+	}
+	struct shm_object *obj = region->shm;
+	struct shm_slot key;
+	key.idx = (page->va - region->start + region->offset) / PGSIZE;
+
+	lock_acquire(&shm_lock);
+	struct hash_elem *e = hash_find(&obj->slots, &key.elem);
+	struct shm_slot *slot = e != NULL ? hash_entry(e, struct shm_slot, elem) : malloc(sizeof *slot);
+	if (slot == NULL)
+	{
+		lock_release(&shm_lock);
+		return false;
+	}
+	if (e == NULL)
+	{
+		slot->obj = obj;
+		slot->idx = key.idx;
+		slot->frame = NULL;
+		slot->busy = false;
+		cond_init(&slot->idle);
+		slot->swap_slot = -1;
+		slot->dirty = false;
+		list_init(&slot->sharers);
+		hash_insert(&obj->slots, &slot->elem);
+	}
+	lock_release(&shm_lock);
+
+	page->operations = obj->inode != NULL ? &shm_file_ops : &shm_anon_ops;
+	page->shared.slot = slot;
+	return true;
+}
+
+/* Claim the shared page PAGE: map the frame of its slot, bringing
+ * it in first if no process has it in memory.  Sharers that fault
+ * on the page while one of them reads it wait for that read. */
+bool shm_claim(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) == VM_UNINIT && !shm_attach(page))
+	{
+		return false;
+	}
+	struct shm_slot *slot = page->shared.slot;
+
+	lock_acquire(&shm_lock);
+	// 다른 프로세스가 이미 읽고 있으면 같은 페이지를 또 읽지 않고 그 읽기를 기다린다.
+	while (slot->busy)
+	{
+		cond_wait(&slot->idle, &shm_lock);
+	}
+	if (slot->frame == NULL)
+	{
+		// 디스크 읽기와 축출은 오래 걸리므로 락을 놓고 프레임을 채운다.
+		slot->busy = true;
+		lock_release(&shm_lock);
+		struct frame *frame = vm_get_frame();
+		bool success = frame != NULL;
+		if (success)
+		{
+			frame->page = page;
+			bool released = vm_io_begin();
+			success = slot_read(slot, frame->kva);
+			vm_io_end(released);
+		}
+		lock_acquire(&shm_lock);
+		slot->busy = false;
+		cond_broadcast(&slot->idle, &shm_lock);
+		if (!success)
+		{
+			lock_release(&shm_lock);
+			if (frame != NULL)
+			{
+				vm_free_frame(frame);
+			}
+			return false;
+		}
+		slot->frame = frame;
+		if (slot->swap_slot >= 0)
+		{
+			anon_swap_drop(slot->swap_slot);
+			slot->swap_slot = -1;
+		}
+	}
+	if (!pml4_set_page(page->owner->pml4, page->va, slot->frame->kva, page->writable))
+	{
+		lock_release(&shm_lock);
+		return false;
+	}
+	vm_page_set_frame(page, slot->frame);
+	if (slot->frame->page == NULL)
+	{
+		slot->frame->page = page;
+	}
+	list_push_back(&slot->sharers, &page->shared.elem);
+	lock_release(&shm_lock);
+	return true;
+}
+
+/* Shared pages are brought in by shm_claim(), which maps the frame
+ * of their slot instead of filling a frame of their own. */
+static bool
+shm_swap_in(struct page *page UNUSED, void *kva UNUSED)
+{
+	return false;
+}
+
+/* Evict the frame of PAGE's slot from every process sharing it,
+ * writing it back first.  Returns the frame, or NULL if another
+ * sharer evicted it already or swap is full. */
+struct frame *
+shm_evict(struct page *page)
+{
+	struct shm_slot *slot = page->shared.slot;
+
+	lock_acquire(&shm_lock);
+	struct frame *frame = slot->frame;
+	if (frame == NULL || frame->pin_cnt > 0 || slot->busy)
+	{
+		lock_release(&shm_lock);
+		return NULL;
+	}
+	// 쓰는 동안 아무도 고치지 못하게 먼저 모든 공유자에게서 떼어 낸다. 더러운지는 그 전에 본다.
+	bool dirty = slot->obj->inode != NULL && slot_dirty(slot);
+	while (!list_empty(&slot->sharers))
+	{
+		struct page *p = list_entry(list_pop_front(&slot->sharers), struct page, shared.elem);
+		pml4_clear_page(p->owner->pml4, p->va);
+		vm_page_clear_frame(p);
+	}
+	slot->frame = NULL;
+	slot->busy = true;
+	lock_release(&shm_lock);
+
+	int swap_slot = -1;
+	if (slot->obj->inode == NULL)
+	{
+		swap_slot = anon_swap_write(frame->kva);
+	}
+	else if (dirty)
+	{
+		file_write_at(slot->obj->file, frame->kva, file_bytes(slot), slot->idx * PGSIZE);
+	}
+
+	lock_acquire(&shm_lock);
+	slot->busy = false;
+	cond_broadcast(&slot->idle, &shm_lock);
+	if (slot->obj->inode == NULL && swap_slot < 0)
+	{
+		// swap이 가득 찼다. 프레임을 슬롯에 되돌려 두면 공유자들이 폴트 때 다시 매핑한다.
+		frame->page = NULL;
+		slot->frame = frame;
+		lock_release(&shm_lock);
+		return NULL;
+	}
+	slot->swap_slot = swap_slot;
+	slot->dirty = false;
+	lock_release(&shm_lock);
+	return frame;
+}
+
+static bool
+shm_swap_out(struct page *page)
+{
+	return shm_evict(page) != NULL;
+}
+
+/* Detach PAGE from its slot.  The last sharer of a file page writes
+ * it back and frees the frame; an anonymous page keeps it for the
+ * next process to map the object. */
+static void
+shm_destroy(struct page *page)
+{
+	struct shm_slot *slot = page->shared.slot;
+	struct frame *frame = page->frame;
+
+	lock_acquire(&shm_lock);
+	if (frame != NULL)
+	{
+		if (page->locked)
+		{
+			frame->pin_cnt--;
+		}
+		if (pml4_is_dirty(page->owner->pml4, page->va))
+		{
+			slot->dirty = true;
+		}
+		list_remove(&page->shared.elem);
+		vm_unmap_page(page);
+		page->frame = NULL;
+		if (frame->page == page)
+		{
+			// 축출 때 쓸 대표 페이지를 살아 있는 다른 공유자로 바꾼다.
+			frame->page = list_empty(&slot->sharers)
+							  ? NULL
+							  : list_entry(list_front(&slot->sharers), struct page, shared.elem);
+		}
+		if (list_empty(&slot->sharers) && slot->obj->inode != NULL)
+		{
+			// 마지막 공유자다. 파일에 쓰는 동안에는 락을 놓고, 그 사이 폴트는 쓰기가 끝나길 기다린다.
+			bool dirty = slot->dirty;
+			slot->frame = NULL;
+			slot->dirty = false;
+			slot->busy = true;
+			lock_release(&shm_lock);
+			if (dirty)
+			{
+				file_write_at(slot->obj->file, frame->kva, file_bytes(slot), slot->idx * PGSIZE);
+			}
+			vm_free_frame(frame);
+			lock_acquire(&shm_lock);
+			slot->busy = false;
+			cond_broadcast(&slot->idle, &shm_lock);
+		}
+	}
+	lock_release(&shm_lock);
+}
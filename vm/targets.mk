@@ -2,4 +2,14 @@ vm_SRC = vm/vm.c          # Main api proxy
 vm_SRC += vm/uninit.c     # Uninitialized page
 vm_SRC += vm/anon.c       # Anonymous page
 vm_SRC += vm/file.c       # File mapped page
+vm_SRC += vm/region.c     # Address-space regions
+vm_SRC += vm/ksm.c        # Same-page merging
+vm_SRC += vm/madvise.c    # Access-pattern hints
+vm_SRC += vm/mlock.c      # Locked and pinned pages
+vm_SRC += vm/shm.c        # Shared memory
+vm_SRC += vm/memstat.c    # Per-process memory accounting
+vm_SRC += vm/aging.c      # Page aging for eviction
+vm_SRC += vm/writeback.c  # Batched file writeback
+vm_SRC += vm/workingset.c # Refault detection
+vm_SRC += vm/faultstat.c  # Fault latency statistics
 vm_SRC += vm/inspect.c    # Testing utility
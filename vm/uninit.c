@@ -10,6 +10,8 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
 
 static bool uninit_initialize(struct page *page, void *kva);
 static void uninit_destroy(struct page *page);
@@ -50,10 +52,17 @@ uninit_initialize(struct page *page, void *kva)
 	/* Fetch first, page_initialize may overwrite the values */
 	vm_initializer *init = uninit->init;
 	void *aux = uninit->aux;
+	enum vm_type type = uninit->type;
 
 	/* TODO: You may need to fix this function. */
-	return uninit->page_initializer(page, uninit->type, kva) &&
-		   (init ? init(page, aux) : true);
+	bool success = uninit->page_initializer(page, type, kva) &&
+				   (init ? init(page, aux) : true);
+	// anon 페이지는 내용을 채운 뒤로 load_info를 쓰지 않는다.
+	if (VM_TYPE(type) == VM_ANON)
+	{
+		kmem_cache_free(load_info_cache, aux);
+	}
+	return success;
 }
 
 /* Free the resources hold by uninit_page. Although most of pages are transmuted
@@ -63,7 +72,9 @@ uninit_initialize(struct page *page, void *kva)
 static void
 uninit_destroy(struct page *page)
 {
-	struct uninit_page *uninit UNUSED = &page->uninit;
+	struct uninit_page *uninit = &page->uninit;
 	/* TODO: Fill this function.
 	 * TODO: If you don't have anything to do, just return. */
+	// 한 번도 올라오지 않은 페이지의 load_info
+	kmem_cache_free(load_info_cache, uninit->aux);
 }
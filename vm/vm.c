@@ -1,10 +1,24 @@
 /* vm.c: Generic interface for virtual memory objects. */
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/ksm.h"
+#include "vm/aging.h"
+#include "vm/writeback.h"
+#include "vm/workingset.h"
+#include "vm/faultstat.h"
+#include "vm/madvise.h"
 #include "threads/mmu.h"
 #include "vm/uninit.h"
 #include <string.h>
+#include <user/syscall.h>
+
+/* Object caches for the structures made and freed on every fault. */
+struct kmem_cache *vm_page_cache;
+struct kmem_cache *vm_frame_cache;
+struct kmem_cache *load_info_cache;
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void vm_init(void)
@@ -17,6 +31,19 @@ void vm_init(void)
 	register_inspect_intr();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	// 폴트마다 만들고 지우는 구조체는 전용 캐시에서 받는다.
+	vm_page_cache = kmem_cache_create("page", sizeof(struct page), NULL);
+	vm_frame_cache = kmem_cache_create("frame", sizeof(struct frame), NULL);
+	load_info_cache = kmem_cache_create("load_info", sizeof(struct load_info), NULL);
+	if (vm_page_cache == NULL || vm_frame_cache == NULL || load_info_cache == NULL)
+	{
+		PANIC("vm_init: cannot create object caches");
+	}
+	ksm_init();
+	aging_init();
+	workingset_init();
+	madvise_init();
+	shm_init();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -36,9 +63,19 @@ page_get_type(struct page *page)
 }
 
 /* Helpers */
-static struct frame *vm_get_victim(void);
-static bool vm_do_claim_page(struct page *page);
+static struct page *vm_get_victim(void);
 static struct frame *vm_evict_frame(void);
+static struct frame *frame_alloc(void);
+
+/* Fault-around window bounds, in pages.  A fault on a lazily loaded
+ * file page also maps up to this many following pages of the same
+ * segment or mapping. */
+#define FAULT_AROUND_INIT 4
+#define FAULT_AROUND_MAX 16
+
+/* Times vm_evict_frame() looks for a victim, yielding in between,
+ * before it gives up and lets the fault fail. */
+#define EVICT_RETRIES 64
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -67,7 +104,7 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
 	 * TODO: uninit_new를 호출한 후에 필드를 수정해야 합니다. */
 
 	/* TODO: 페이지를 spt에 삽입합니다. */
-	struct page *new_page = malloc(sizeof(struct page));
+	struct page *new_page = kmem_cache_alloc(vm_page_cache);
 
 	if (new_page == NULL)
 	{
@@ -93,7 +130,7 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
 	break;
 	// 필요한 다른 페이지 타입을 추가할 수 있습니다.
 	default:
-		free(new_page);
+		kmem_cache_free(vm_page_cache, new_page);
 		goto err; // 지원하지 않는 페이지 타입인 경우
 	}
 	// uninit_new를 호출하여 페이지 초기화
@@ -101,9 +138,10 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
 	// 바뀔 타입 : VM_TYPE(type)
 	uninit_new(new_page, upage, init, type, aux, page_initializer);
 	new_page->writable = writable;
+	new_page->owner = thread_current();
 	if (!spt_insert_page(spt, new_page))
 	{
-		free(new_page);
+		kmem_cache_free(vm_page_cache, new_page);
 		goto err;
 	}
 
@@ -112,113 +150,429 @@ err:
 	return false;
 }
 
+/* The supplemental page table is a radix tree with the same shape as
+ * the x86-64 page table: four levels of 512-entry nodes indexed by
+ * 9-bit slices of the virtual page number.  A lookup is four
+ * dependent loads, and walking the tree visits pages in address
+ * order.  Each node fills exactly one page. */
+#define SPT_BITS 9
+#define SPT_FANOUT (1 << SPT_BITS)
+#define SPT_LEVELS 4
+
+struct spt_node
+{
+	void *slot[SPT_FANOUT]; // 아래 단계 노드, 마지막 단계면 struct page
+};
+
+/* Index of VA in a node at LEVEL (0 is the root). */
+static inline size_t
+spt_index(void *va, int level)
+{
+	int shift = PGBITS + (SPT_LEVELS - 1 - level) * SPT_BITS;
+	return ((uint64_t)va >> shift) & (SPT_FANOUT - 1);
+}
+
+/* Returns the leaf slot for VA in SPT.  If CREATE, missing nodes on
+ * the way are allocated; otherwise returns NULL when one is missing
+ * (or when allocation fails). */
+static struct page **
+spt_slot(struct supplemental_page_table *spt, void *va, bool create)
+{
+	struct spt_node **node = &spt->root;
+	for (int level = 0; level < SPT_LEVELS; level++)
+	{
+		if (*node == NULL)
+		{
+			if (!create || (*node = palloc_get_page(PAL_ZERO)) == NULL)
+			{
+				return NULL;
+			}
+		}
+		node = (struct spt_node **)&(*node)->slot[spt_index(va, level)];
+	}
+	return (struct page **)node;
+}
+
+/* Calls ACTION on every page in NODE, a node at LEVEL, in address
+ * order.  Stops and returns false as soon as ACTION does. */
+static bool
+spt_walk(struct spt_node *node, int level, spt_action_func *action, void *aux)
+{
+	for (size_t i = 0; i < SPT_FANOUT; i++)
+	{
+		void *child = node->slot[i];
+		if (child == NULL)
+		{
+			continue;
+		}
+		if (level == SPT_LEVELS - 1 ? !action(child, aux) : !spt_walk(child, level + 1, action, aux))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Calls ACTION with AUX on every page of SPT in address order,
+ * stopping early if it returns false.  Returns true if every call
+ * returned true.  ACTION must not add pages to or remove pages from
+ * SPT. */
+bool spt_apply(struct supplemental_page_table *spt, spt_action_func *action, void *aux)
+{
+	return spt->root == NULL || spt_walk(spt->root, 0, action, aux);
+}
+
+/* Frees NODE, a node at LEVEL, and every node below it.  Pages are
+ * not touched. */
+static void
+spt_free_nodes(struct spt_node *node, int level)
+{
+	if (level < SPT_LEVELS - 1)
+	{
+		for (size_t i = 0; i < SPT_FANOUT; i++)
+		{
+			if (node->slot[i] != NULL)
+			{
+				spt_free_nodes(node->slot[i], level + 1);
+			}
+		}
+	}
+	palloc_free_page(node);
+}
+
+/* Returns true if SPT holds no page in the HPGSIZE block at BASE.
+ * The block is exactly the span of one leaf node. */
+static bool
+spt_block_empty(struct supplemental_page_table *spt, void *base)
+{
+	struct spt_node *node = spt->root;
+	for (int level = 0; level < SPT_LEVELS - 1 && node != NULL; level++)
+	{
+		node = node->slot[spt_index(base, level)];
+	}
+	if (node == NULL)
+	{
+		return true;
+	}
+	for (size_t i = 0; i < SPT_FANOUT; i++)
+	{
+		if (node->slot[i] != NULL)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
 spt_find_page(struct supplemental_page_table *spt UNUSED, void *va UNUSED)
 {
-	// printf("%p\n", va);
-	struct page page;
-	/* TODO: Fill this function. */
-	struct hash_elem *e;
-	page.va = va;
-	// spt의 해시 테이블에서 p와 같은 va를 가진 엔트리를 찾습니다.
-	e = hash_find(&spt->vm, &page.hash_elem);
-	// 해당 엔트리가 존재하면, struct page 포인터를 반환하고, 없으면 NULL을 반환합니다.
-	return e != NULL ? hash_entry(e, struct page, hash_elem) : NULL;
+	struct page **slot = spt_slot(spt, va, false);
+	return slot != NULL ? *slot : NULL;
+}
+
+/* Like spt_find_page(), but if VA lies in a region where no page
+ * has been created yet, create it from the region first. */
+struct page *
+spt_get_page(struct supplemental_page_table *spt, void *va)
+{
+	struct page *page = spt_find_page(spt, pg_round_down(va));
+	if (page == NULL)
+	{
+		page = region_populate(spt, va);
+	}
+	return page;
 }
 
 /* Insert PAGE into spt with validation. */
 bool spt_insert_page(struct supplemental_page_table *spt UNUSED,
 					 struct page *page UNUSED)
 {
-	int succ = false;
 	/* TODO: Fill this function. */
+	struct page **slot = spt_slot(spt, page->va, true);
 
 	// 보조 페이지 테이블에서 가상 주소가 이미 존재하는지 확인
-
-	// printf("이잉ㅇㅇ\n");
-	succ = hash_insert(&spt->vm, &page->hash_elem) == NULL;
-	// printf("삽입 성공 : %d\n", succ);
-
-	return succ;
+	if (slot == NULL || *slot != NULL)
+	{
+		return false;
+	}
+	*slot = page;
+	return true;
 }
 
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
 {
+	*spt_slot(spt, page->va, false) = NULL;
 	vm_dealloc_page(page);
-	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
-static struct frame *
+/* Best victim found so far by victim_scan(). */
+struct victim
+{
+	struct page *page;
+	unsigned score; // aging_score(), 낮을수록 먼저 쫓아낸다
+};
+
+/* spt_apply() callback of vm_get_victim(): remember PAGE if it is a
+ * better victim than the best one so far, that is, if its
+ * aging_score() is lower.  A page of a region advised
+ * MADV_SEQUENTIAL is taken right away and ends the scan: the lowest
+ * such page is the one a forward pass is most likely done with. */
+static bool
+victim_scan(struct page *page, void *victim_)
+{
+	struct victim *victim = victim_;
+	if (page->frame == NULL || is_pinned_page(page))
+	{
+		return true;
+	}
+	struct vm_region *region = region_find(&thread_current()->spt, page->va);
+	if (region != NULL && region->advice == MADV_SEQUENTIAL)
+	{
+		victim->page = page;
+		return false;
+	}
+	// 공유 프레임의 대표 페이지는 다른 프로세스 것일 수 있어 프레임이 아니라 페이지를 고른다.
+	unsigned score = aging_score(page);
+	if (victim->page == NULL || score < victim->score)
+	{
+		victim->page = page;
+		victim->score = score;
+	}
+	// aged가 없으면 스캔이 직접 accessed 비트를 지워 두 번째 기회를 준다.
+	if (aging_interval_ms == 0)
+	{
+		pml4_set_accessed(thread_current()->pml4, page->va, false);
+	}
+	// 오랫동안 안 쓴 깨끗한 페이지보다 나은 후보는 없다.
+	return score != 0;
+}
+
+/* Get the page of the current process, whose frame will be evicted. */
+static struct page *
 vm_get_victim(void)
 {
-	struct frame *victim = NULL;
+	struct victim victim = {NULL, 0};
 	/* TODO: The policy for eviction is up to you. */
+	spt_apply(&thread_current()->spt, victim_scan, &victim);
+	return victim.page;
+}
 
-	struct hash_iterator i;
-
-	hash_first(&i, &thread_current()->spt.vm);
-	while (hash_next(&i))
+/* Evict one page and return the corresponding frame.
+ * Return NULL on error, or if the current process has nothing to
+ * evict and no frame frees up within EVICT_RETRIES tries.*/
+static struct frame *
+vm_evict_frame(void)
+{
+	/* TODO: swap out the victim and return the evicted frame. */
+	uint64_t start = faultstat_start();
+	for (int try = 0; try < EVICT_RETRIES; try++)
 	{
-
-		struct page *page = hash_entry(hash_cur(&i), struct page, hash_elem);
-		if (page->frame == NULL)
+		struct page *victim = vm_get_victim();
+		if (victim == NULL)
 		{
+			// rss 상한 때문에 내보내려는데 고정된 페이지뿐이면 상한을 넘겨서라도 빈 프레임을 쓴다.
+			struct frame *frame = frame_alloc();
+			if (frame != NULL)
+			{
+				return frame;
+			}
+			// 프레임이 모두 다른 프로세스 것이다. 그쪽이 끝나거나 내보내길 기다렸다가 다시 본다.
+			thread_yield();
 			continue;
 		}
-		// 특정 가상 페이지가 최근에 접근 되었는 지 확인
-		if (!pml4_is_accessed(thread_current()->pml4, page->va))
+		// 병합된 페이지는 그 페이지만 내보낸다. 다른 공유자가 남아 있으면 프레임은 돌려받지 못한다.
+		if (ksm_is_merged(victim))
 		{
-			// 접근한 지 오래되었으면 쫒아낼 프레임으로 선정
-			victim = page->frame;
+			struct frame *frame = ksm_evict(victim);
+			if (frame != NULL)
+			{
+				workingset_eviction(victim);
+				faultstat_record(FAULT_EVICT, start);
+				return frame;
+			}
+			continue;
 		}
-		else
+		// 공유 페이지와 코드 페이지는 모든 공유자에게서 한꺼번에 내보낸다. 다른 공유자가 먼저 내보냈을 수도 있다.
+		if (is_shared_page(victim) || is_text_page(victim))
 		{
-			pml4_set_accessed(thread_current()->pml4, page->va, false);
+			struct frame *frame = is_text_page(victim) ? text_evict(victim) : shm_evict(victim);
+			if (frame != NULL)
+			{
+				workingset_eviction(victim);
+				faultstat_record(FAULT_EVICT, start);
+				return frame;
+			}
+			continue;
+		}
+		struct frame *frame = victim->frame;
+		if (!swap_out(victim))
+		{
+			return NULL;
 		}
+		workingset_eviction(victim);
+		faultstat_record(FAULT_EVICT, start);
+		return frame;
 	}
-	return victim;
+	return NULL;
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+/* palloc() a zeroed user page and wrap it in a frame.  Returns NULL
+ * when the user pool is exhausted. */
 static struct frame *
-vm_evict_frame(void)
+frame_alloc(void)
 {
-	struct frame *victim = vm_get_victim();
-	/* TODO: swap out the victim and return the evicted frame. */
-	while (victim == NULL)
+	void *kva = palloc_get_page(PAL_USER | PAL_ZERO);
+	if (kva == NULL)
+	{
+		return NULL;
+	}
+	struct frame *frame = kmem_cache_alloc(vm_frame_cache);
+	if (frame == NULL)
+	{
+		palloc_free_page(kva);
+		return NULL;
+	}
+	frame->kva = kva;
+	frame->owner = thread_current();
+	frame->page = NULL;
+	frame->pin_cnt = 0;
+	return frame;
+}
+
+/* palloc() a user page and wrap it in a frame, without evicting
+ * anything.  Returns NULL when the user pool is exhausted or the
+ * current process has reached its rss limit.  Used by opportunistic
+ * work such as swap readahead, which should only consume memory that
+ * is already free. */
+struct frame *
+vm_try_get_frame(void)
+{
+	// 상한에 닿은 프로세스는 빈 프레임이 남아 있어도 자기 페이지를 내보내고 그 프레임을 쓴다.
+	if (vm_rss_over_limit(thread_current(), 1))
+	{
+		return NULL;
+	}
+	return frame_alloc();
+}
+
+/* Release FRAME and its user page.  The caller must already have
+ * unlinked it from its page and cleared the mapping.  During a
+ * batched unmap the page is only freed after the TLB flush. */
+void vm_free_frame(struct frame *frame)
+{
+	struct mmu_gather *tlb = thread_current()->spt.tlb;
+	if (tlb != NULL)
+	{
+		mmu_gather_free_page(tlb, frame->kva);
+	}
+	else
+	{
+		palloc_free_page(frame->kva);
+	}
+	kmem_cache_free(vm_frame_cache, frame);
+}
+
+/* Remove the mapping of PAGE, which must belong to the current
+ * thread.  During a batched unmap the TLB entry is left to the
+ * batch's flush. */
+void vm_unmap_page(struct page *page)
+{
+	struct thread *cur = thread_current();
+	ASSERT(page->owner == cur);
+
+	if (cur->spt.tlb != NULL)
 	{
-		victim = vm_get_victim();
-		// thread_yield();
+		mmu_gather_clear_page(cur->spt.tlb, page->va);
 	}
-	if (!swap_out(victim->page))
+	else
+	{
+		pml4_clear_page(cur->pml4, page->va);
+	}
+}
+
+/* Release the spt lock of the current thread, if it holds it, for
+ * the duration of a disk read that fills a frame no page of the
+ * table points to yet.  ksmd, aged and the willneed thread can then
+ * work on the process meanwhile.  Returns whether the lock was
+ * released; pass it to vm_io_end(). */
+bool vm_io_begin(void)
+{
+	struct lock *lock = &thread_current()->spt.lock;
+	if (!lock_held_by_current_thread(lock))
+	{
+		return false;
+	}
+	lock_release(lock);
+	return true;
+}
+
+/* Take back the spt lock released by vm_io_begin(), if RELEASED. */
+void vm_io_end(bool released)
+{
+	if (released)
 	{
-		victim = NULL;
+		lock_acquire(&thread_current()->spt.lock);
 	}
-	return victim;
+}
+
+/* Add DELTA to COUNTER, one of the memory counters of a thread.
+ * Besides the owner, ksmd, the willneed thread and the sharers of a
+ * shared frame link and unlink a process's pages, so the update must
+ * not be interrupted halfway. */
+void vm_account(size_t *counter, int delta)
+{
+	enum intr_level old_level = intr_disable();
+	*counter += delta;
+	intr_set_level(old_level);
+}
+
+/* Link PAGE to FRAME and count it in the resident set of PAGE's
+ * owner. */
+void vm_page_set_frame(struct page *page, struct frame *frame)
+{
+	ASSERT(page->frame == NULL);
+	page->frame = frame;
+	page->age = 0;
+	vm_account(&page->owner->rss, 1);
+}
+
+/* Unlink PAGE from its frame and take it out of the resident set of
+ * its owner.  What happens to the frame is up to the caller.  Pages
+ * being destroyed are taken out by vm_dealloc_page() instead. */
+void vm_page_clear_frame(struct page *page)
+{
+	ASSERT(page->frame != NULL);
+	page->frame = NULL;
+	vm_account(&page->owner->rss, -1);
+}
+
+/* Returns true if mapping CNT more pages would take T over its rss
+ * limit. */
+bool vm_rss_over_limit(struct thread *t, size_t cnt)
+{
+	return t->rss_limit != 0 && t->rss + cnt > t->rss_limit;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
-static struct frame *
+ * and return it. That is, if the user pool memory is full, this function
+ * evicts the frame to get the available memory space.  Returns NULL only
+ * if nothing can be evicted either; the fault then fails.*/
+struct frame *
 vm_get_frame(void)
 {
 	// 슬아 추가
+	struct frame *frame = vm_try_get_frame();
 
-	struct frame *frame = malloc(sizeof(struct frame));
-
-	frame->kva = palloc_get_page(PAL_USER | PAL_ZERO);
-
-	if (frame == NULL || frame->kva == NULL)
+	if (frame == NULL)
 	{
-		palloc_free_page(frame->kva);
-		free(frame);
 		// 꺼지게 할 프레임 vm_evict_frame()함수로 찾아서 넣기
 		frame = vm_evict_frame();
+		if (frame == NULL)
+		{
+			return NULL;
+		}
 		// 가상주소에 있는 값 페이지 사이즈 만큼 0 으로 초기화
 		memset(frame->kva, 0, PGSIZE);
 	}
@@ -231,40 +585,306 @@ vm_get_frame(void)
 	return frame;
 }
 
-/* Growing the stack. */
-static void
+/* Growing the stack: only the page at ADDR, in the stack region, is
+ * created and claimed.  Pages between it and the part of the stack
+ * already in use stay unbacked until they are touched themselves. */
+static bool
 vm_stack_growth(void *addr UNUSED)
 {
-	while (addr != USER_STACK - PGSIZE)
+	// 폴트 처리 중이라 spt 락을 이미 잡고 있다.
+	struct page *page = region_populate(&thread_current()->spt, addr);
+	return page != NULL && vm_do_claim_page(page);
+}
+
+/* Returns true if PAGE has not been loaded yet and will be filled
+ * from a file (executable segment or mmap) when it is. */
+static bool
+is_file_backed_uninit(struct page *page)
+{
+	return page != NULL && VM_TYPE(page->operations->type) == VM_UNINIT &&
+		   page->uninit.init != NULL;
+}
+
+/* Returns true if NEXT continues the run of file pages ending with
+ * PREV: same loader, same file, and either the very next page of
+ * the file or a page that is entirely zero-filled. */
+static bool
+fault_around_continues(struct page *prev, struct page *next)
+{
+	if (!is_file_backed_uninit(next) || next->uninit.init != prev->uninit.init)
+	{
+		return false;
+	}
+	struct load_info *a = prev->uninit.aux;
+	struct load_info *b = next->uninit.aux;
+	if (a->file != b->file)
+	{
+		return false;
+	}
+	if (b->read_bytes == 0)
+	{
+		return true;
+	}
+	return a->read_bytes == PGSIZE && b->offset == a->offset + PGSIZE;
+}
+
+/* Fill the frames of the CNT file pages in RUN from their file.
+ * Leading whole pages are fetched with one multi-sector read, the
+ * rest one by one; bytes past read_bytes are zeroed. */
+static bool
+fault_around_load(struct page *run[], int cnt)
+{
+	struct load_info *first = run[0]->uninit.aux;
+	void *bufs[FAULT_AROUND_MAX];
+	int full = 0;
+
+	while (full < cnt && ((struct load_info *)run[full]->uninit.aux)->read_bytes == PGSIZE)
+	{
+		bufs[full] = run[full]->frame->kva;
+		full++;
+	}
+	if (full > 0 && file_read_pages(first->file, bufs, full, first->offset) != full * PGSIZE)
+	{
+		// 한 번에 읽을 수 없으면 아래에서 한 장씩 읽는다.
+		full = 0;
+	}
+
+	for (int i = full; i < cnt; i++)
+	{
+		struct load_info *info = run[i]->uninit.aux;
+		void *kva = run[i]->frame->kva;
+		if (file_read_at(info->file, kva, info->read_bytes, info->offset) != (int)info->read_bytes)
+		{
+			return false;
+		}
+		memset(kva + info->read_bytes, 0, PGSIZE - info->read_bytes);
+	}
+	return true;
+}
+
+/* Resolve a fault on the lazily loaded file page PAGE, mapping the
+ * following not yet loaded pages of the same segment or mapping
+ * with it.  The window doubles while faults keep landing right
+ * behind the previous window (sequential access) and halves when
+ * they do not (random access).  A region advised MADV_SEQUENTIAL
+ * always gets the largest window and one advised MADV_RANDOM none.
+ * Pages past the first are only loaded into frames that are free
+ * already; fault-around never evicts anything. */
+static bool
+vm_fault_around(struct page *page)
+{
+	struct thread *cur = thread_current();
+	struct page *run[FAULT_AROUND_MAX];
+	struct vm_region *region = region_find(&cur->spt, page->va);
+	int advice = region != NULL ? region->advice : MADV_NORMAL;
+	int window = cur->fa_window != 0 ? cur->fa_window : FAULT_AROUND_INIT;
+
+	if (advice == MADV_SEQUENTIAL)
+	{
+		window = FAULT_AROUND_MAX;
+	}
+	else if (advice == MADV_RANDOM)
+	{
+		window = 1;
+	}
+	else
+	{
+		// 직전 창 바로 뒤에서 폴트가 났으면 순차 접근으로 보고 창을 키운다.
+		if (page->va == cur->fa_next)
+		{
+			window = window * 2 > FAULT_AROUND_MAX ? FAULT_AROUND_MAX : window * 2;
+		}
+		else if (window > 1)
+		{
+			window /= 2;
+		}
+		cur->fa_window = window;
+	}
+
+	int cnt = 1;
+	run[0] = page;
+	while (cnt < window)
+	{
+		struct page *next = spt_get_page(&cur->spt, page->va + cnt * PGSIZE);
+		if (!fault_around_continues(run[cnt - 1], next))
+		{
+			break;
+		}
+		run[cnt++] = next;
+	}
+
+	// 폴트 난 페이지는 반드시, 나머지는 남는 프레임이 있을 때만 올린다.
+	for (int i = 0; i < cnt; i++)
+	{
+		struct frame *frame = i == 0 ? vm_get_frame() : vm_try_get_frame();
+		if (frame == NULL)
+		{
+			cnt = i;
+			break;
+		}
+		frame->page = run[i];
+		vm_page_set_frame(run[i], frame);
+	}
+
+	if (cnt == 0)
+	{
+		return false;
+	}
+	if (!fault_around_load(run, cnt))
+	{
+		for (int i = 0; i < cnt; i++)
+		{
+			vm_free_frame(run[i]->frame);
+			vm_page_clear_frame(run[i]);
+		}
+		return false;
+	}
+
+	for (int i = 0; i < cnt; i++)
+	{
+		struct page *p = run[i];
+		// 내용은 이미 읽어 두었으니 초기화 때 다시 읽지 않도록 한다.
+		p->uninit.init = NULL;
+		if (!pml4_set_page(cur->pml4, p->va, p->frame->kva, p->writable))
+		{
+			PANIC("매핑실패\n");
+		}
+		if (!swap_in(p, p->frame->kva))
+		{
+			return false;
+		}
+	}
+	cur->fa_next = page->va + cnt * PGSIZE;
+	return true;
+}
+
+/* Resolve a fault in an anonymous region by mapping the whole 2 MB
+ * block around ADDR with one huge page.  This is only done when the
+ * region covers the block, none of its pages exists yet and an
+ * aligned run of free frames is available.  Every 4 kB page still
+ * gets its own struct page and frame, so eviction can split the
+ * mapping later and deal with the pages one by one. */
+static bool
+vm_huge_fault(void *addr)
+{
+	struct thread *cur = thread_current();
+	struct supplemental_page_table *spt = &cur->spt;
+	void *base = hpg_round_down(addr);
+	struct vm_region *region = region_find(spt, addr);
+
+	if (region == NULL || VM_TYPE(region->type) != VM_ANON || (region->type & (VM_STACK | VM_SHARED)) ||
+		!region->writable ||
+		base < region->start || base + HPGSIZE > region->end || !spt_block_empty(spt, base) ||
+		vm_rss_over_limit(cur, HPGSIZE / PGSIZE))
+	{
+		return false;
+	}
+	uint8_t *kva = palloc_get_huge_page(PAL_USER | (region->init == NULL ? PAL_ZERO : 0));
+	if (kva == NULL)
 	{
-		if (!vm_alloc_page(VM_ANON | VM_STACK, addr, true))
+		return false;
+	}
+
+	size_t cnt;
+	for (cnt = 0; cnt < HPGSIZE / PGSIZE; cnt++)
+	{
+		struct page *page = region_populate(spt, base + cnt * PGSIZE);
+		if (page == NULL)
+		{
+			break;
+		}
+		struct frame *frame = kmem_cache_alloc(vm_frame_cache);
+		if (frame == NULL)
 		{
-			PANIC("스택페이지 할당실패\n");
+			spt_remove_page(spt, page);
+			break;
 		}
-		if (!vm_claim_page(addr))
+		frame->kva = kva + cnt * PGSIZE;
+		frame->page = page;
+		frame->owner = cur;
+		frame->pin_cnt = 0;
+		vm_page_set_frame(page, frame);
+		if (!swap_in(page, frame->kva))
 		{
-			PANIC("스택페이지 클레임 실패\n");
+			vm_page_clear_frame(page);
+			kmem_cache_free(vm_frame_cache, frame);
+			spt_remove_page(spt, page);
+			break;
 		}
-		addr += PGSIZE;
 	}
+
+	if (cnt < HPGSIZE / PGSIZE || !pml4_set_huge_page(cur->pml4, base, kva, true))
+	{
+		// 하나라도 실패하면 만든 페이지를 모두 지우고 4KB 경로로 넘긴다.
+		for (size_t i = 0; i < cnt; i++)
+		{
+			struct page *page = spt_find_page(spt, base + i * PGSIZE);
+			kmem_cache_free(vm_frame_cache, page->frame);
+			vm_page_clear_frame(page);
+			spt_remove_page(spt, page);
+		}
+		palloc_free_multiple(kva, HPGSIZE / PGSIZE);
+		return false;
+	}
+	return true;
 }
 
 /* Handle the fault on write_protected page */
 static bool
-vm_handle_wp(struct page *page UNUSED)
+vm_handle_wp(struct page *page)
 {
+	if (!page->writable)
+	{
+		return false;
+	}
+	// 같은 내용이라 합쳐 둔 페이지면 쓰는 쪽에 자기 복사본을 준다.
+	if (ksm_is_merged(page))
+	{
+		return ksm_break(page);
+	}
+	// ksmd가 잠깐 쓰기를 막았다가 되돌려 놓은 사이에 난 폴트면 다시 실행하면 된다.
+	uint64_t *pte = pml4e_walk(thread_current()->pml4, (uint64_t)page->va, 0);
+	return pte != NULL && (*pte & PTE_P) && is_writable(pte);
 }
 
-/* Return true on success */
-bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED,
-						 bool user UNUSED, bool write UNUSED, bool not_present UNUSED)
+/* Returns true if resolving a fault on PAGE reads it from disk. */
+static bool
+is_major_fault(struct page *page)
+{
+	if (page->frame != NULL || is_shared_page(page))
+	{
+		return false;
+	}
+	switch (VM_TYPE(page->operations->type))
+	{
+	case VM_UNINIT:
+		return is_file_backed_uninit(page);
+	case VM_ANON:
+		return page->anon.swap_slot >= 0;
+	case VM_FILE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Resolve the fault at ADDR.  The spt lock is held.  Stores the
+ * FAULT_* kind of work the fault took in *KIND. */
+static bool
+vm_handle_fault(void *addr, void *rsp, bool write, bool not_present, int *kind)
 {
 	// printf("addr : %p\n", addr);
 	// printf("round addr : %p\n", pg_round_down(addr));
 	struct thread *cur = thread_current();
 	struct supplemental_page_table *spt UNUSED = &cur->spt;
+	*kind = FAULT_MINOR;
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
+	// 2MB가 통째로 비어 있는 익명 구역이면 큰 페이지 하나로 매핑한다.
+	if (not_present && vm_huge_fault(addr))
+	{
+		return true;
+	}
 	struct page *page = spt_find_page(spt, pg_round_down(addr));
 	// printf("page write : %d\n", page->writable);
 	// printf(" 스레드 rsp : %p\n", cur->rsp);
@@ -275,55 +895,117 @@ bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED,
 
 	if (page == NULL)
 	{
-
-		void *stack_boundary = (void *)(((uint32_t *)USER_STACK) - MAX_STACK_SIZE);
-		if (addr > stack_boundary && write)
+		struct vm_region *region = region_find(spt, addr);
+		if (region != NULL && (region->type & VM_STACK))
 		{
-
-			if (USER_STACK > addr && user)
-			{
-				vm_stack_growth(pg_round_down(addr));
-				return true;
-			}
+			// rsp 아래로는 push가 쓰는 8바이트까지만 스택으로 인정한다.
+			*kind = FAULT_STACK;
+			return addr >= rsp - 8 && vm_stack_growth(addr);
 		}
-		else
+		if ((page = spt_get_page(spt, addr)) == NULL)
 		{
 			return false;
 		}
 	}
 	// printf("dfgfgfgf\n");
 
-	// 페이지 클레임
-	if (!vm_do_claim_page(page))
+	// 올라와 있는 페이지에 쓰다가 난 폴트
+	if (page != NULL && !not_present && write && vm_handle_wp(page))
 	{
-		return false;
+		*kind = FAULT_COW;
+		return true;
+	}
+
+	// 디스크에서 읽어 와야 하는 페이지인지는 클레임 전에 보고, 세는 것은 성공한 뒤에 한다.
+	bool major = is_major_fault(page);
+
+	// 파일에서 읽어올 페이지면 뒤따르는 페이지들까지 함께 올린다.
+	if (is_file_backed_uninit(page))
+	{
+		if (!vm_fault_around(page))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// 얼마 전에 쫓아낸 페이지가 돌아왔으면 작업 집합에 드는 페이지이니 바로 다시 쫓아내지 않게 한다.
+		bool active = not_present && workingset_refault(page);
+
+		// 페이지 클레임
+		if (!vm_do_claim_page(page))
+		{
+			return false;
+		}
+		if (active)
+		{
+			page->age = AGE_ACTIVE;
+		}
+	}
+	if (major)
+	{
+		cur->major_fault_cnt++;
+		*kind = FAULT_MAJOR;
 	}
 	return true;
 }
 
+/* Return true on success */
+bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED,
+						 bool user UNUSED, bool write UNUSED, bool not_present UNUSED)
+{
+	uint64_t start = faultstat_start();
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	// 시스템 콜 처리 중 커널에서 난 폴트면 진입할 때 저장해 둔 사용자 rsp를 쓴다.
+	void *rsp = user ? (void *)f->rsp : (void *)thread_current()->rsp;
+	int kind;
+	// ksmd가 이 프로세스의 페이지를 건드리지 못하게 폴트 처리 내내 잡아 둔다.
+	lock_acquire(&spt->lock);
+	bool success = vm_handle_fault(addr, rsp, write, not_present, &kind);
+	if (success)
+	{
+		thread_current()->fault_cnt++;
+	}
+	lock_release(&spt->lock);
+	if (success)
+	{
+		faultstat_record(kind, start);
+	}
+	return success;
+}
+
 /* Free the page.
  * DO NOT MODIFY THIS FUNCTION. */
 void vm_dealloc_page(struct page *page)
 {
+	if (page->locked)
+	{
+		page->owner->spt.locked_cnt--;
+	}
+	// 타입별 destroy가 프레임을 어떻게 놓든 여기서 한 번만 rss에서 뺀다.
+	if (page->frame != NULL)
+	{
+		vm_account(&page->owner->rss, -1);
+	}
 	destroy(page);
-	free(page);
+	kmem_cache_free(vm_page_cache, page);
 }
 
 /* Claim the page that allocate on VA. */
 bool vm_claim_page(void *va UNUSED)
 {
 	/* TODO: Fill this function */
-	struct page *page = spt_find_page(&thread_current()->spt, va);
-	if (page == NULL)
-	{
-		return false;
-	}
-	return vm_do_claim_page(page);
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	lock_acquire(&spt->lock);
+	struct page *page = spt_get_page(spt, va);
+	bool success = page != NULL && vm_do_claim_page(page);
+	lock_release(&spt->lock);
+	return success;
 }
 
-/* Claim the PAGE and set up the mmu. */
-static bool
-vm_do_claim_page(struct page *page)
+/* Claim the PAGE and set up the mmu.  The caller must hold the
+ * spt lock of the current process, which PAGE belongs to. */
+bool vm_do_claim_page(struct page *page)
 {
 	// write_code 통과용 틀어막기 코드..
 	if (pml4_get_page(thread_current()->pml4, page->va) && !page->writable)
@@ -331,10 +1013,24 @@ vm_do_claim_page(struct page *page)
 		sys_exit(-1);
 	}
 	//
+	// 실행 파일 코드 페이지는 다른 프로세스와 프레임을 공유한다.
+	if (is_text_page(page))
+	{
+		return file_text_claim(page);
+	}
+	// 공유 메모리 페이지는 공유 객체의 프레임을 매핑한다.
+	if (is_shared_page(page))
+	{
+		return shm_claim(page);
+	}
 	struct frame *frame = vm_get_frame();
+	if (frame == NULL)
+	{
+		return false;
+	}
 	/* Set links */
 	frame->page = page;
-	page->frame = frame;
+	vm_page_set_frame(page, frame);
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
 	//&thread_current()->pml4 이거 아님!!! 이거 주소 기호 떼주니까 통과됨!!!!
 	if (!pml4_set_page(thread_current()->pml4, page->va, page->frame->kva, page->writable))
@@ -352,51 +1048,129 @@ vm_do_claim_page(struct page *page)
 void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED)
 {
 
-	hash_init(&spt->vm, page_hash_func, page_less_func, NULL);
+	spt->root = NULL;
+	spt->tlb = NULL;
+	spt->wb = NULL;
+	region_table_init(spt);
+	lock_init(&spt->lock);
+	spt->live = true;
+	spt->locked_cnt = 0;
+	ksm_add(spt);
+	aging_add(spt);
 }
 
-/* Copy supplemental page table from src to dst */
-bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
-								  struct supplemental_page_table *src UNUSED)
+/* spt_apply() callback of supplemental_page_table_copy(): give the
+ * child DST its own copy of PARENT_PAGE. */
+static bool
+spt_copy_page(struct page *parent_page, void *dst_)
 {
-	struct hash_iterator i;
-	hash_first(&i, &src->vm);
-	while (hash_next(&i))
+	struct supplemental_page_table *dst = dst_;
+	// 가상 주소는 동일하게, 물리주소는 spt 테이블 크기 만큼 다르게 새로 할당
+	// 코드 페이지는 복사하지 않고, 자식이 폴트할 때 같은 프레임을 공유한다.
+	if (is_shared_page(parent_page))
 	{
-
-		// 가상 주소는 동일하게, 물리주소는 spt 테이블 크기 만큼 다르게 새로 할당
-		struct page *parent_page = hash_entry(hash_cur(&i), struct page, hash_elem);
-		if (VM_TYPE(parent_page->operations->type) == VM_ANON || VM_TYPE(parent_page->operations->type) == VM_FILE)
+		// 공유 페이지는 구역을 물려받은 자식이 폴트 때 같은 프레임을 매핑한다.
+		return true;
+	}
+	if (is_text_page(parent_page))
+	{
+		struct load_info *src_info = VM_TYPE(parent_page->operations->type) == VM_UNINIT
+										 ? parent_page->uninit.aux
+										 : parent_page->file.fr;
+		struct load_info *aux = kmem_cache_alloc(load_info_cache);
+		if (aux == NULL)
+		{
+			return false;
+		}
+		memcpy(aux, src_info, sizeof(struct load_info));
+		aux->file = region_find(dst, parent_page->va)->file;
+		if (!vm_alloc_page_with_initializer(VM_FILE | VM_TEXT, parent_page->va, false, NULL, aux))
+		{
+			kmem_cache_free(load_info_cache, aux);
+			return false;
+		}
+	}
+	else if (VM_TYPE(parent_page->operations->type) == VM_FILE && parent_page->frame == NULL)
+	{
+		// 파일에 이미 써 둔 페이지는 자식이 구역에서 다시 읽으면 된다.
+		return true;
+	}
+	else if (VM_TYPE(parent_page->operations->type) == VM_ANON || VM_TYPE(parent_page->operations->type) == VM_FILE)
+	{
+		struct load_info *aux = NULL;
+		if (VM_TYPE(parent_page->operations->type) == VM_FILE)
+		{
+			aux = region_load_info(region_find(dst, parent_page->va), parent_page->va);
+		}
+		if (!vm_alloc_page_with_initializer(parent_page->operations->type, parent_page->va, parent_page->writable, NULL, aux))
+		{
+			printf("생성실패!\n");
+			return false;
+		}
+		struct page *new_page = spt_find_page(dst, parent_page->va);
+		if (!vm_do_claim_page(new_page))
+		{
+			return false;
+		}
+		if (parent_page->frame != NULL)
 		{
-
-			if (!vm_alloc_page_with_initializer(parent_page->operations->type, parent_page->va, parent_page->writable, NULL, NULL))
-			{
-				printf("생성실패!\n");
-				return false;
-			}
-			struct page *new_page = spt_find_page(dst, parent_page->va);
-			if (!vm_do_claim_page(new_page))
-			{
-				return false;
-			}
 			memcpy(new_page->frame->kva, parent_page->frame->kva, PGSIZE);
 		}
-		else if (VM_TYPE(parent_page->operations->type) == VM_UNINIT)
+		else if (parent_page->anon.swap_slot >= 0)
 		{
-			void *aux = malloc(sizeof(struct load_info));
-			memcpy(aux, parent_page->uninit.aux, sizeof(struct load_info));
-			// uninit.type 이건 바뀔 타입 !!!
-			if (!vm_alloc_page_with_initializer(parent_page->uninit.type, parent_page->va, parent_page->writable, parent_page->uninit.init, aux))
-			{
-				free(aux);
-				return false;
-			}
+			// 부모 페이지가 swap에 내려가 있으면 슬롯에서 바로 읽는다. 부모의 슬롯은 그대로 둔다.
+			anon_swap_read(parent_page->anon.swap_slot, new_page->frame->kva);
+		}
+		// 둘 다 아니면 내용을 버린 페이지(MADV_DONTNEED)라 0으로 채운 프레임 그대로 둔다.
+	}
+	else if (VM_TYPE(parent_page->operations->type) == VM_UNINIT && parent_page->uninit.aux == NULL)
+	{
+		// 아직 건드리지 않은 스택 페이지는 자식도 폴트 때 구역에서 만든다.
+		return true;
+	}
+	else if (VM_TYPE(parent_page->operations->type) == VM_UNINIT)
+	{
+		struct load_info *aux = kmem_cache_alloc(load_info_cache);
+		if (aux == NULL)
+		{
+			return false;
 		}
-		else
+		memcpy(aux, parent_page->uninit.aux, sizeof(struct load_info));
+		aux->file = region_find(dst, parent_page->va)->file;
+		// uninit.type 이건 바뀔 타입 !!!
+		if (!vm_alloc_page_with_initializer(parent_page->uninit.type, parent_page->va, parent_page->writable, parent_page->uninit.init, aux))
 		{
+			kmem_cache_free(load_info_cache, aux);
 			return false;
 		}
 	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+/* Copy supplemental page table from src to dst */
+bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
+								  struct supplemental_page_table *src UNUSED)
+{
+	// 복사하는 동안 ksmd가 부모나 자식의 페이지를 합치지 못하게 한다.
+	lock_acquire(&dst->lock);
+	lock_acquire(&src->lock);
+	// 구역을 먼저 복사해 두면 아직 만들어지지 않은 페이지는 자식이 알아서 만든다.
+	bool success = region_table_copy(dst, src) && spt_apply(src, spt_copy_page, dst);
+	lock_release(&src->lock);
+	lock_release(&dst->lock);
+	return success;
+}
+
+/* spt_apply() callback of supplemental_page_table_kill(). */
+static bool
+spt_free_page(struct page *page, void *aux UNUSED)
+{
+	// 타입별 자원을 정리한다. 수정된 mmap 페이지는 여기서 파일에 다시 쓴다.
+	vm_dealloc_page(page);
 	return true;
 }
 
@@ -405,11 +1179,77 @@ void supplemental_page_table_kill(struct supplemental_page_table *spt UNUSED)
 {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
-	hash_clear(&spt->vm, free_hash_func);
+	// 더 이상 ksmd가 훑지 않게 한다. 폴트 처리 중에 죽는 경우엔 락을 이미 잡고 있다.
+	bool live = spt->live;
+	if (live)
+	{
+		// 미리 읽기 요청을 거둬들인다. 처리 중이면 끝날 때까지 기다린다.
+		madvise_cancel(spt);
+		if (!lock_held_by_current_thread(&spt->lock))
+		{
+			lock_acquire(&spt->lock);
+		}
+		ksm_remove(spt);
+		aging_remove(spt);
+		spt->live = false;
+	}
+	// 페이지마다 TLB를 비우지 않고 배치 단위로 비운다.
+	// 수정된 mmap 페이지도 모았다가 파일 오프셋 순으로 이어서 쓴다.
+	struct mmu_gather tlb;
+	struct writeback wb;
+	mmu_gather_init(&tlb, thread_current()->pml4);
+	writeback_init(&wb);
+	spt->tlb = &tlb;
+	spt->wb = &wb;
+	spt_apply(spt, spt_free_page, NULL);
+	writeback_finish(&wb);
+	spt->wb = NULL;
+	spt->tlb = NULL;
+	mmu_gather_finish(&tlb);
+	if (spt->root != NULL)
+	{
+		spt_free_nodes(spt->root, 0);
+		spt->root = NULL;
+	}
+	region_table_kill(spt);
+	if (live)
+	{
+		lock_release(&spt->lock);
+	}
 }
 
 // 비트플래그를 사용하여 스택페이지인지 표시함.
 bool is_stack_page(struct page *page)
 {
 	return VM_TYPE(page->operations->type) & VM_STACK;
-}
\ No newline at end of file
+}
+
+/* Returns true if PAGE is read-only executable text whose frame is
+ * shared through the text cache, whether or not it has been loaded
+ * yet. */
+bool is_text_page(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+	{
+		return page->uninit.type & VM_TEXT;
+	}
+	return page->operations->type & VM_TEXT;
+}
+
+/* Returns true if PAGE must stay in its frame: it was mlock()ed, or
+ * the kernel is doing I/O on its frame (vm_pin_range()). */
+bool is_pinned_page(struct page *page)
+{
+	return page->locked || (page->frame != NULL && page->frame->pin_cnt > 0);
+}
+
+/* Returns true if PAGE belongs to a shared memory object, whether
+ * or not it has been loaded yet. */
+bool is_shared_page(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+	{
+		return page->uninit.type & VM_SHARED;
+	}
+	return page->operations->type & VM_SHARED;
+}
@@ -0,0 +1,133 @@
+/* workingset.c: Refault detection for eviction.
+ *
+ * Every eviction leaves a shadow entry behind: which page went, and
+ * the value of a clock that counts evictions.  When the page faults
+ * back in, the distance between the two clock values is the number
+ * of pages evicted while it was out.  If that is no more than its
+ * process's resident set, a few more frames would have kept it, so
+ * the page is part of the working set and was evicted too early.
+ * Such a page starts its new residency as active (aged all
+ * recently) instead of as the first victim.
+ *
+ * Refaults also steer the balance between the two kinds of victim.
+ * Eviction prefers pages that can be dropped without a write (clean
+ * file pages) over pages that must go to swap or back to their file
+ * by a margin, the writeback cost added to their aging score.  A
+ * clean file page that refaults shows that dropping them is not
+ * free after all and lowers the margin; an anonymous page that
+ * refaults raises it again.
+ *
+ * The shadow index is small and direct-mapped: a newer eviction that
+ * lands in the same slot replaces the older one, which is then just
+ * not recognized when it refaults. */
+
+#include "vm/workingset.h"
+#include "vm/vm.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* Number of shadow entries. */
+#define SHADOW_CNT 512
+
+/* Bounds and step of the writeback cost.  It starts in the middle. */
+#define COST_MIN 0x00
+#define COST_MAX 0x80
+#define COST_STEP 4
+
+/* A page that was evicted. */
+struct shadow
+{
+	struct thread *owner; // 쫓겨난 페이지의 프로세스, 빈 칸이면 NULL
+	void *va;
+	size_t evicted_at; // 쫓겨날 때의 evictions 값
+};
+
+/* Protects everything below. */
+static struct lock shadow_lock;
+static struct shadow shadows[SHADOW_CNT];
+static size_t evictions; // 지금까지 쫓아낸 페이지 수, 거리를 재는 시계로 쓴다
+static unsigned writeback_cost = (COST_MIN + COST_MAX) / 2;
+
+/* Statistics. */
+static size_t refaults;	   // 그림자가 남아 있던 페이지의 폴트 수
+static size_t activations; // 그중 작업 집합 안에서 다시 쓰인 것
+
+/* Initializes refault detection. */
+void workingset_init(void)
+{
+	lock_init(&shadow_lock);
+}
+
+/* Returns the shadow slot of the page at VA of OWNER. */
+static struct shadow *
+shadow_slot(struct thread *owner, void *va)
+{
+	uintptr_t h = ((uintptr_t)va >> PGBITS) ^ ((uintptr_t)owner >> PGBITS) * 31;
+	return &shadows[h % SHADOW_CNT];
+}
+
+/* Records that PAGE is being evicted. */
+void workingset_eviction(struct page *page)
+{
+	lock_acquire(&shadow_lock);
+	struct shadow *s = shadow_slot(page->owner, page->va);
+	s->owner = page->owner;
+	s->va = page->va;
+	s->evicted_at = evictions++;
+	lock_release(&shadow_lock);
+}
+
+/* Called when PAGE, which is not resident, faults.  Returns true if
+ * PAGE was evicted recently enough to belong to the working set of
+ * its process, in which case it should start out as recently used. */
+bool workingset_refault(struct page *page)
+{
+	if (page->frame != NULL || VM_TYPE(page->operations->type) == VM_UNINIT)
+	{
+		return false;
+	}
+	lock_acquire(&shadow_lock);
+	struct shadow *s = shadow_slot(page->owner, page->va);
+	if (s->owner != page->owner || s->va != page->va)
+	{
+		lock_release(&shadow_lock);
+		return false;
+	}
+	size_t distance = evictions - s->evicted_at;
+	s->owner = NULL;
+	refaults++;
+
+	bool active = distance <= page->owner->rss;
+	if (active)
+	{
+		activations++;
+		// 깨끗한 파일 페이지가 금방 돌아왔으면 버리기를 덜 선호하고, 익명 페이지면 더 선호한다.
+		if (VM_TYPE(page->operations->type) == VM_FILE)
+		{
+			writeback_cost = writeback_cost > COST_MIN + COST_STEP ? writeback_cost - COST_STEP : COST_MIN;
+		}
+		else
+		{
+			writeback_cost = writeback_cost + COST_STEP < COST_MAX ? writeback_cost + COST_STEP : COST_MAX;
+		}
+	}
+	lock_release(&shadow_lock);
+	return active;
+}
+
+/* Score added to a victim candidate that must be written out to be
+ * evicted.  See aging_score(). */
+unsigned workingset_writeback_cost(void)
+{
+	return writeback_cost;
+}
+
+/* Prints refault statistics. */
+void workingset_print_stats(void)
+{
+	printf("Workingset: %zu evictions, %zu refaults, %zu activated, writeback cost %u\n",
+		   evictions, refaults, activations, writeback_cost);
+}
@@ -0,0 +1,98 @@
+/* writeback.c: Sorted, coalesced writeback of dirty file pages.
+ *
+ * Unmapping a file mapping or tearing down a process used to write
+ * every dirty page on its own, sector by sector, in whatever order
+ * the pages were destroyed.  Inside a writeback batch the pages are
+ * collected first, then sorted by file offset, and every run of
+ * pages that are adjacent in the file is written with a single
+ * multi-sector transfer (file_write_pages()).  File data lies
+ * contiguously on disk, so a run in the file is a run on disk. */
+
+#include "vm/writeback.h"
+#include "vm/vm.h"
+#include "filesys/file.h"
+#include "threads/vaddr.h"
+#include <stdio.h>
+
+/* Statistics. */
+static size_t pages_written; // 배치로 쓴 페이지 수
+static size_t transfers;	 // 그 페이지들을 쓰는 데 든 디스크 전송 수
+
+/* Start an empty batch WB. */
+void writeback_init(struct writeback *wb)
+{
+	wb->file = NULL;
+	wb->cnt = 0;
+}
+
+/* Write out and free the pages of WB. */
+static void
+writeback_flush(struct writeback *wb)
+{
+	// 많아야 WRITEBACK_PAGES개라 삽입 정렬로 충분하다.
+	for (size_t i = 1; i < wb->cnt; i++)
+	{
+		struct writeback_page p = wb->pages[i];
+		size_t j = i;
+		for (; j > 0 && wb->pages[j - 1].offset > p.offset; j--)
+		{
+			wb->pages[j] = wb->pages[j - 1];
+		}
+		wb->pages[j] = p;
+	}
+
+	size_t i = 0;
+	while (i < wb->cnt)
+	{
+		struct writeback_page *run = &wb->pages[i];
+		void *kvas[WRITEBACK_PAGES];
+		size_t n = 0;
+		// 꽉 찬 페이지 바로 뒤에 오는 페이지는 같은 전송에 붙인다.
+		do
+		{
+			kvas[n] = run[n].frame->kva;
+			n++;
+		} while (i + n < wb->cnt && run[n - 1].bytes == PGSIZE &&
+				 run[n].offset == run[n - 1].offset + PGSIZE);
+
+		file_write_pages(wb->file, kvas, n, run[0].offset, (off_t)(n - 1) * PGSIZE + run[n - 1].bytes);
+		pages_written += n;
+		transfers++;
+		for (size_t j = 0; j < n; j++)
+		{
+			vm_free_frame(run[j].frame);
+		}
+		i += n;
+	}
+	wb->cnt = 0;
+}
+
+/* Queue the first BYTES bytes of FRAME, which hold the page at
+ * OFFSET of FILE, to be written by WB.  FRAME must no longer be
+ * mapped; WB frees it once it is written. */
+void writeback_add(struct writeback *wb, struct file *file, off_t offset, off_t bytes,
+				   struct frame *frame)
+{
+	if (wb->cnt == WRITEBACK_PAGES || (wb->cnt > 0 && wb->file != file))
+	{
+		writeback_flush(wb);
+	}
+	wb->file = file;
+	wb->pages[wb->cnt].offset = offset;
+	wb->pages[wb->cnt].bytes = bytes;
+	wb->pages[wb->cnt].frame = frame;
+	wb->cnt++;
+}
+
+/* End the batch WB, writing out whatever it still holds. */
+void writeback_finish(struct writeback *wb)
+{
+	writeback_flush(wb);
+	wb->file = NULL;
+}
+
+/* Prints writeback statistics. */
+void writeback_print_stats(void)
+{
+	printf("Writeback: %zu pages in %zu transfers\n", pages_written, transfers);
+}